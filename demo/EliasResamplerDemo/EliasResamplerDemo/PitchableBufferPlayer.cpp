@@ -38,6 +38,9 @@ namespace Tonic { namespace Tonic_{
     mLPF = new LPF12();
     resampler->setInterpolator(mInterpolator);
     resampler->addLowPassFilter(mLPF);
+    // precompute the octaves down, so pitching up doesn't have to filter the whole buffer over again every time
+    mMipmap.build(buffer_.dataPointer(), buffer_.frames(), buffer_.channels(), RealtimeResampler::Renderer::MAX_DECIMATION_STAGES);
+    resampler->setMaxDecimationStages(RealtimeResampler::Renderer::MAX_DECIMATION_STAGES);
     resampler->setAudioSource(this);
   }
   
@@ -102,6 +105,21 @@ namespace Tonic { namespace Tonic_{
     return totalFramesCopied;
 
   }
+  
+  int PitchableBufferPlayer_::getNumOctaves(){
+    // the octaves only line up with the buffer played straight through
+    return mDoesLoop ? 0 : mMipmap.getNumOctavesAt(currentFrame);
+  }
+  
+  size_t PitchableBufferPlayer_::getOctaveSamples(RealtimeResampler::SampleType* outputBuffer, size_t numFramesRequested, int numChannels, int octave){
+    size_t framesRead = mMipmap.read(octave, currentFrame, outputBuffer, numFramesRequested);
+    currentFrame = min(((currentFrame >> octave) + framesRead) << octave, (size_t)buffer_.frames());
+    return framesRead;
+  }
+  
+  void PitchableBufferPlayer_::getOctaveHistory(RealtimeResampler::SampleType* outputBuffer, size_t numFrames, int numChannels, int octave){
+    mMipmap.readHistory(octave, currentFrame, outputBuffer, numFrames);
+  }
 
 
 } // Namespace Tonic_
@@ -41,6 +41,7 @@ namespace Tonic {
         size_t calculateFramesLeftInBuffer();
         RealtimeResampler::Interpolator* mInterpolator;
         RealtimeResampler::Filter* mLPF;
+        RealtimeResampler::MipmapTable mMipmap;
 
     public:
         PitchableBufferPlayer_();
@@ -59,6 +60,9 @@ namespace Tonic {
           playbackRateIsOne = false;
         }
         size_t getSamples(RealtimeResampler::SampleType* outputBuffer, size_t numFramesRequested, int numChannels);
+        int getNumOctaves();
+        size_t getOctaveSamples(RealtimeResampler::SampleType* outputBuffer, size_t numFramesRequested, int numChannels, int octave);
+        void getOctaveHistory(RealtimeResampler::SampleType* outputBuffer, size_t numFrames, int numChannels, int octave);
       
 
     };
@@ -11,240 +11,238 @@
 
 #include "RealtimeResampler.h"
 #include <cstdlib>
-#include <algorithm>
-#include <math.h>
-#include "RealtimeResamplerInterpolator.h"
-#include "RealtimeResamplerFilter.h"
+#include <cstring>
 #include <cassert>
-
-#ifndef REALTIME_RESAMPLER_BUFFER_BACK_PADDING
-  #define REALTIME_RESAMPLER_BUFFER_BACK_PADDING 2
-#endif
-
-#ifndef REALTIME_RESAMPLER_BUFFER_FRONT_PADDING
-  #define REALTIME_RESAMPLER_BUFFER_FRONT_PADDING 2
-#endif
+#include <algorithm>
 
 namespace RealtimeResampler {
 
   void* (*mallocFn)(size_t) = malloc;
   void (*freeFn)(void*) = free;
   
-  
-  
-  const int Renderer::BUFFER_BACK_PADDING = REALTIME_RESAMPLER_BUFFER_BACK_PADDING;
-  const int Renderer::BUFFER_FRONT_PADDING = REALTIME_RESAMPLER_BUFFER_FRONT_PADDING;
+  // Renderer's render loop is compiled once here rather than in every file that includes the header.
+  template class BasicRenderer<DynamicInterpolator, 0, DynamicFilterChain>;
   
   Renderer::Renderer(float sampleRate, int numChannels, size_t sourceBufferLength, size_t maxFramesToRender ) :
-    mNumChannels(numChannels),
-    mCurrentPitch(1),
-    mPitchDestination(1),
-    mSecondsUntilPitchDestination(0),
-    mSampleRate(sampleRate),
-    mMaxFramesToRender(maxFramesToRender),
-    mSourceBufferLength(sourceBufferLength),
-    mSourceBuffer1( sourceBufferLength, numChannels, BUFFER_FRONT_PADDING, BUFFER_BACK_PADDING),
-    mSourceBuffer2( sourceBufferLength, numChannels, BUFFER_FRONT_PADDING, BUFFER_BACK_PADDING),
-    mBufferSwapState(0),
-    mSourceBufferReadHead(sourceBufferLength),
-    mPitchBuffer(maxFramesToRender, 1),
-    mInterpolationPositionBuffer(maxFramesToRender, 1),
-    mLpfCount(0)
+    BasicRenderer<DynamicInterpolator, 0, DynamicFilterChain>(sampleRate, numChannels, sourceBufferLength, maxFramesToRender),
+    mNumFilters(0)
   {
   }
   
   Renderer::~Renderer(){
   }
   
+  void Renderer::setInterpolator(RealtimeResampler::Interpolator *interpolator){
+    mInterpolator.setInterpolator(interpolator);
+    allocateSourceBuffers();
+  }
   
-  void Renderer::reset(){
-      mSourceBuffer1.length = 0;
-      mSourceBuffer2.length = 0;
-      for(int i = 0; i < mLpfCount; i++){
-        mLPF[i]->reset();
-      }
+  void Renderer::addLowPassFilter(Filter* filter){
+    mFilters.add(filter);
+    mNumFilters = std::min(mNumFilters + 1, (int)DynamicFilterChain::MAX_FILTERS);
   }
-
-  size_t Renderer::getNumChannels(){
-    return mNumChannels;
-  }
-  
-  size_t Renderer::render(SampleType* outputBuffer, size_t numFramesRequested){
-  
-    memset(outputBuffer, 0, numFramesRequested * mNumChannels * sizeof(SampleType));
-    
-    assert(numFramesRequested <= mMaxFramesToRender);
-    
-    size_t numFramesRendered = 0;
-    
-    calculatePitchForNextFrames(numFramesRequested);
-    
-    Buffer* currentBuffer = mBufferSwapState ? &mSourceBuffer1 : &mSourceBuffer2;
-     
-    while (numFramesRendered < numFramesRequested) {
-        
-      // load the source data if necessary
-      if(mSourceBufferReadHead >= currentBuffer->length){
-        swapBuffersAndFillNext();
-        currentBuffer = mBufferSwapState ? &mSourceBuffer1 : &mSourceBuffer2;
-      }
-    
-      // how many frames to render in this pass
-      size_t interpolatedFramesToRender = 0;
-  
-      // last calculated interpolation position. Initalize it to be the last position read
-      // this may be in the middle of a source buffer
-      float interpPosition = mSourceBufferReadHead;
-     
-      int interpPositionOffset = (int)mSourceBufferReadHead;
-      
-      // build the interpolation position buffer
-      //  - keep track of how big it is
-      //  - make sure we're not using more frames than are currently in the source buffer
-      //  - make sure we're not rendering more frames than requested
-      //  - when we build the mInterpolationPositionBuffer, compensate for the fact that readhead has an offset. this could be optimized better.
-      while(
-        (interpPosition) < currentBuffer->length
-        && ((interpolatedFramesToRender + numFramesRendered) < numFramesRequested)
-      ){
-        size_t pitchBufferPosition = numFramesRendered + interpolatedFramesToRender;
-        mInterpolationPositionBuffer.getStartPtr()[interpolatedFramesToRender] = interpPosition - interpPositionOffset;
-        interpPosition += mPitchBuffer.getStartPtr()[pitchBufferPosition];
-        interpolatedFramesToRender++;
-      }
-      
-      // render the interpolated data
-      
-      // start where we left off
-      SampleType* writeHead = outputBuffer + numFramesRendered * mNumChannels;
-      SampleType* readHead = currentBuffer->getStartPtr() + ((int)mSourceBufferReadHead) * mNumChannels;
-      
-      // no need to interpolate if the pitch is zero
-      if( mCurrentPitch == 1 && mPitchDestination == 1){
-        memcpy(writeHead, readHead, interpolatedFramesToRender * mNumChannels * sizeof(SampleType));
-      }else{
-        // otherwise, use the interpolator
-        // interpolate [interpolatedFramesToRender] frames starting at readHead, writing to writehead
-        // and using interpolationBuffer for frame position and interpolation coefficient
-        for(int channel = 0; channel < mNumChannels; channel++){
-          mInterpolator->process(readHead + channel, writeHead + channel, mInterpolationPositionBuffer.getStartPtr(), interpolatedFramesToRender, mNumChannels);
-        }
-      }
-      
-
   
-      // increment our total frame count
-      numFramesRendered += interpolatedFramesToRender;
-      
-     // printf("interpolatedFramesToRender: %i\n", interpolatedFramesToRender);
-      
-      // update the source buffer read head
-      mSourceBufferReadHead = interpPosition;
-  
-      // if the current sourceBuffer is not full, that means the audiosource didn't supply enough samples
-      if (currentBuffer->length < mSourceBufferLength) {
-        reset();
-        break;
-      }
-      
+  void Renderer::clearLowPassfilters(){
+    mFilters.clear();
+    mNumFilters = 0;
+  }
+  
+  void Renderer::reserveInterpolatorSupport(int leftSupport, int rightSupport){
+    mMaxFrontPadding = std::max(mMaxFrontPadding, leftSupport);
+    mMaxBackPadding = std::max(mMaxBackPadding, rightSupport);
+    allocateSourceBuffers();
+  }
+  
+  bool Renderer::queueInterpolator(Interpolator* interpolator, uint64_t frame){
+    // The source buffers can't grow on the audio thread
+    if (!interpolator || interpolator->getLeftSupport() > mMaxFrontPadding || interpolator->getRightSupport() > mMaxBackPadding) {
+      return false;
     }
-    return numFramesRendered;
-    
+    RendererCommand command = RendererCommand();
+    command.type = RendererCommand::SET_INTERPOLATOR;
+    command.frame = frame;
+    command.object = interpolator;
+    return mCommands.push(command);
   }
   
-  void Renderer::setAudioSource(AudioSource* audioSource){
-    mAudioSource = audioSource;
+  bool Renderer::queueLowPassFilter(Filter* filter, uint64_t frame){
+    // The chain would drop it
+    if (mNumFilters == DynamicFilterChain::MAX_FILTERS) {
+      return false;
+    }
+    mFilters.initFilter(filter);
+    RendererCommand command = RendererCommand();
+    command.type = RendererCommand::ADD_LOW_PASS_FILTER;
+    command.frame = frame;
+    command.object = filter;
+    if (!mCommands.push(command)) {
+      return false;
+    }
+    mNumFilters++;
+    return true;
   }
   
-  void Renderer::setPitch(float start, float end, float glideDuration){
-      mCurrentPitch = start;
-      mPitchDestination = end;
-      mSecondsUntilPitchDestination = glideDuration;
+  bool Renderer::queueClearLowPassFilters(uint64_t frame){
+    RendererCommand command = RendererCommand();
+    command.type = RendererCommand::CLEAR_LOW_PASS_FILTERS;
+    command.frame = frame;
+    if (!mCommands.push(command)) {
+      return false;
+    }
+    mNumFilters = 0;
+    return true;
   }
   
-  void Renderer::calculatePitchForNextFrames(size_t numFrames){
-    double pitchChangePerFrame;
-    if (mSecondsUntilPitchDestination > 0) {
-      pitchChangePerFrame = (mPitchDestination - mCurrentPitch) / (mSecondsUntilPitchDestination * mSampleRate);
-    }else{
-      pitchChangePerFrame = 0;
+  void Renderer::applyCommand(const RendererCommand& command){
+    switch (command.type) {
+      case RendererCommand::SET_INTERPOLATOR:
+        // The source buffers are already big enough, so carry on from the read position. Only the weights worked out for
+        // the old interpolator are out of date.
+        mInterpolator.setInterpolator((Interpolator*)command.object);
+        mFrontPadding = mInterpolator.getLeftSupport();
+        mBackPadding = mInterpolator.getRightSupport();
+        mPeriodicPhases = 0;
+        mRatioWeightsPitch = 0;
+        break;
+      case RendererCommand::ADD_LOW_PASS_FILTER:
+        mFilters.addInitialized((Filter*)command.object);
+        break;
+      case RendererCommand::CLEAR_LOW_PASS_FILTERS:
+        clearLowPassfilters();
+        break;
+      default:
+        BasicRenderer<DynamicInterpolator, 0, DynamicFilterChain>::applyCommand(command);
+        break;
     }
-    double secondsPerFrame = 1.0 / mSampleRate;
-    for (int frame = 0; frame < numFrames; frame++) {
-      mSecondsUntilPitchDestination -= secondsPerFrame;
-      mCurrentPitch += pitchChangePerFrame;
-      if (mSecondsUntilPitchDestination <=0) {
-        mSecondsUntilPitchDestination = 0;
-        pitchChangePerFrame = 0;
-        mCurrentPitch = mPitchDestination;
-      }
-      mPitchBuffer.getStartPtr()[frame] = mCurrentPitch;
+  }
+  
+  MipmapSource::MipmapSource() :
+    mTable(0),
+    mPosition(0)
+  {
+  }
+  
+  void MipmapSource::setTable(MipmapTable* table){
+    mTable = table;
+    mPosition = 0;
+  }
+  
+  void MipmapSource::setPosition(size_t position){
+    mPosition = position;
+  }
+  
+  size_t MipmapSource::getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels){
+    return getOctaveSamples(outputBuffer, numFramesRequested, numChannels, 0);
+  }
+  
+  int MipmapSource::getNumOctaves(){
+    return mTable ? mTable->getNumOctavesAt(mPosition) : 0;
+  }
+  
+  size_t MipmapSource::getOctaveSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels, int octave){
+    if (!mTable) {
+      return 0;
     }
+    assert(numChannels == mTable->getNumChannels());
+    size_t framesRead = mTable->read(octave, mPosition, outputBuffer, numFramesRequested);
+    mPosition = ((mPosition >> octave) + framesRead) << octave;
+    return framesRead;
   }
   
+  const SampleType* MipmapSource::borrowSamples(size_t maxFrames, size_t* numFramesBorrowed, int numChannels){
+    // The original frames are the table's source buffer
+    if (!mTable || mPosition >= mTable->getNumFrames(0)) {
+      return 0;
+    }
+    assert(numChannels == mTable->getNumChannels());
+    const SampleType* frames = mTable->getFrames(0) + mPosition * numChannels;
+    *numFramesBorrowed = std::min(maxFrames, mTable->getNumFrames(0) - mPosition);
+    mPosition += *numFramesBorrowed;
+    return frames;
+  }
   
-  void Renderer::fillSourceBuffer(Buffer* buf){
-    buf->length = mAudioSource->getSamples(buf->getStartPtr(), mSourceBufferLength, mNumChannels);
+  void MipmapSource::getOctaveHistory(SampleType* outputBuffer, size_t numFrames, int numChannels, int octave){
+    if (!mTable) {
+      memset(outputBuffer, 0, numFrames * numChannels * sizeof(SampleType));
+      return;
+    }
+    assert(numChannels == mTable->getNumChannels());
+    mTable->readHistory(octave, mPosition, outputBuffer, numFrames);
   }
   
-  void Renderer::filterBuffer(Buffer* buf){
-    // There's no need to anti-alias if we're pitching down
-    if(mCurrentPitch > 1){
-      // Attenuate frequencies above nyquist. Use the start of the pitch buffer for
-      // convenience. There will be some error in the case of wild pitch bends,
-      // but it is assumed that this approach is good enough.
-      for(int i = 0; i < mLpfCount; i++){
-        mLPF[i]->process(buf, mLPF[i]->pitchFactorToCutoff(*mPitchBuffer.getStartPtr()));
-      }
+  CommandQueue::CommandQueue(size_t minCapacity) :
+    mCommands(0),
+    mCapacity(1),
+    mWritePosition(0),
+    mReadPosition(0),
+    mFrame(0)
+  {
+    while (mCapacity < minCapacity) {
+      mCapacity <<= 1;
     }
+    init();
   }
   
-  void Renderer::swapBuffersAndFillNext(){
+  CommandQueue::CommandQueue(const CommandQueue& other) :
+    mCommands(0),
+    mCapacity(other.mCapacity),
+    mWritePosition(0),
+    mReadPosition(0),
+    mFrame(0)
+  {
+    init();
+  }
+  
+  CommandQueue& CommandQueue::operator= (const CommandQueue& other){
+    mCapacity = other.mCapacity;
+    mWritePosition.store(0);
+    mReadPosition.store(0);
+    mFrame.store(0);
+    init();
+    return *this;
+  }
   
-    mSourceBufferReadHead = fmax(0, mSourceBufferReadHead - mSourceBufferLength);
-    mBufferSwapState = !mBufferSwapState;
-    Buffer* currentBuffer = mBufferSwapState ? &mSourceBuffer1 : &mSourceBuffer2;
-    Buffer* nextBuffer =  !mBufferSwapState ? &mSourceBuffer1 : &mSourceBuffer2;
-    if (currentBuffer->length == 0) {
-      fillSourceBuffer(currentBuffer);
-      // run the buffer through the anti-aliasing filter
-      filterBuffer(currentBuffer);
+  CommandQueue::~CommandQueue(){
+    freeFn(mCommands);
+  }
+  
+  void CommandQueue::init(){
+    if (mCommands) {
+      freeFn(mCommands);
     }
-    
-    fillSourceBuffer(nextBuffer);
-    
-    // zero out the end of the buffer in case it's shorter than we requested
-    memset(nextBuffer->getStartPtr() + nextBuffer->length * mNumChannels, 0, (mSourceBufferLength - nextBuffer->length) * mNumChannels * sizeof(SampleType) );
-    
-    // copy the end of the current buffer into the "hidden" frames below index zero of the next buffer
-    int bufferFrontSampleCount = BUFFER_FRONT_PADDING * mNumChannels;
-    void* nextBufferHiddenFramesStart = nextBuffer->getStartPtr() - bufferFrontSampleCount;
-    void* currentBufCopyStartPoint = currentBuffer->getStartPtr() + currentBuffer->length * mNumChannels - bufferFrontSampleCount;
-    memcpy(nextBufferHiddenFramesStart, currentBufCopyStartPoint, bufferFrontSampleCount * sizeof(SampleType));
-    
-    filterBuffer(nextBuffer);
-    
-    // copy the (filtered) first couple frames of the next buffer on to the end of the current buffer to handle interpolation between the end of the
-    // current and the beginning of the next.
-    memcpy(currentBuffer->getStartPtr() + currentBuffer->length * mNumChannels, nextBuffer->getStartPtr(), BUFFER_BACK_PADDING * mNumChannels * sizeof(SampleType));
-    
+    mCommands = (RendererCommand*)(*mallocFn)(mCapacity * sizeof(RendererCommand));
   }
   
-  void Renderer::setInterpolator(RealtimeResampler::Interpolator *interpolator){
-    mInterpolator = interpolator;
-    mSourceBuffer1 = Buffer( mSourceBufferLength * mNumChannels, BUFFER_FRONT_PADDING * mNumChannels, BUFFER_BACK_PADDING * mNumChannels);
-    mSourceBuffer2= Buffer( mSourceBufferLength * mNumChannels, BUFFER_FRONT_PADDING * mNumChannels, BUFFER_BACK_PADDING * mNumChannels);
+  bool CommandQueue::push(const RendererCommand& command){
+    // The audio thread's position is acquired so a command isn't overwritten while it's still being read, and the new
+    // position released so the audio thread sees the command before it sees the position move past it.
+    size_t writePosition = mWritePosition.load(std::memory_order_relaxed);
+    if (writePosition - mReadPosition.load(std::memory_order_acquire) == mCapacity) {
+      return false;
+    }
+    mCommands[writePosition & (mCapacity - 1)] = command;
+    mWritePosition.store(writePosition + 1, std::memory_order_release);
+    return true;
   }
   
-  void Renderer::addLowPassFilter(Filter* filter){
-    if (mLpfCount < 10) {
-      mLPF[mLpfCount++] = filter;
-      filter->init(mSampleRate, mSourceBufferLength, mNumChannels);
+  const RendererCommand* CommandQueue::peek(){
+    size_t readPosition = mReadPosition.load(std::memory_order_relaxed);
+    if (readPosition == mWritePosition.load(std::memory_order_acquire)) {
+      return 0;
     }
+    return &mCommands[readPosition & (mCapacity - 1)];
   }
   
-  void Renderer::clearLowPassfilters(){
-      mLpfCount = 0;
+  void CommandQueue::pop(){
+    mReadPosition.store(mReadPosition.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+  
+  uint64_t CommandQueue::getFrame(){
+    return mFrame.load(std::memory_order_acquire);
+  }
+  
+  void CommandQueue::setFrame(uint64_t frame){
+    mFrame.store(frame, std::memory_order_release);
   }
 
   
@@ -16,14 +16,19 @@
 #include <stdio.h>
 #include <cstring>
 #include <cstdlib>
+#include <stdint.h>
+#include <climits>
+#include <algorithm>
+#include <cassert>
+#include <math.h>
 #include "RealtimeResamplerBuffer.h"
 #include "RealtimeResamplerCommon.h"
+#include "RealtimeResamplerInterpolator.h"
+#include "RealtimeResamplerFilter.h"
+#include "RealtimeResamplerDecimator.h"
 
 namespace RealtimeResampler {
 
-      class Interpolator;
-      class Filter;
-  
       // allocator / deallocator are malloc and free by default, but can be overridden
       extern void* (*mallocFn)(size_t);
       extern void (*freeFn)(void*);
@@ -48,37 +53,176 @@ namespace RealtimeResampler {
         
         virtual size_t                getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels) = 0;
         
+        /*!
+         A source that keeps its audio decimated ahead of time, such as MipmapSource, returns how many octaves down it can
+         supply from its current position. When the renderer is decimating (see setMaxDecimationStages) it then reads those
+         stages' output from the source with getOctaveSamples, rather than running the decimators itself.
+        */
+        
+        virtual int                   getNumOctaves(){ return 0; }
+        
+        /*!
+         Like getSamples, but at 1 / 2^octave of the source rate, exactly as octave HalfBandDecimators would make it from the
+         source played from its start. Each frame written moves the source on by 2^octave frames.
+        */
+        
+        virtual size_t                getOctaveSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels, int octave){ return 0; }
+        
+        /*!
+         The numFrames frames of octave before the source's current position, oldest first. The position doesn't change.
+        */
+        
+        virtual void                  getOctaveHistory(SampleType* outputBuffer, size_t numFrames, int numChannels, int octave){}
+        
+        /*!
+         A source that already holds its frames in memory can lend them rather than copying them. Returns a pointer to the
+         next frames, sets numFramesBorrowed to how many, up to maxFrames, and moves the source on past them, as getSamples
+         would. The frames must stay put until the next call to any of the source's methods. When the renderer doesn't need to
+         filter or decimate what it reads, it tries this before getSamples, and interpolates straight from the frames, only
+         copying the few at each end that the interpolator reads across the join. Returns 0, and doesn't move the source,
+         if it can't lend the frames, including once it's run dry. The renderer then calls getSamples instead.
+        */
+        
+        virtual const SampleType*     borrowSamples(size_t maxFrames, size_t* numFramesBorrowed, int numChannels){ return 0; }
+        
+      };
+  
+      //////////////////////////////////////////
+      /// MipmapSource class.
+      //////////////////////////////////////////
+  
+      /*!
+        Plays a MipmapTable once through from a start position. At high pitches, a renderer with decimation stages reads the
+        table's precomputed octaves instead of decimating in real time, so many voices playing the same sample pay for the
+        band-limiting once, when the table is built.
+      */
+  
+      class MipmapSource : public AudioSource{
+      
+        public:
+        
+        MipmapSource();
+        
+        // The table isn't copied, and must outlive the source. Moves to the start.
+        void                          setTable(MipmapTable* table);
+        
+        // The position of the next frame, in frames of the original buffer
+        void                          setPosition(size_t position);
+        size_t                        getPosition(){ return mPosition; }
+        
+        size_t                        getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels);
+        int                           getNumOctaves();
+        size_t                        getOctaveSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels, int octave);
+        void                          getOctaveHistory(SampleType* outputBuffer, size_t numFrames, int numChannels, int octave);
+        const SampleType*             borrowSamples(size_t maxFrames, size_t* numFramesBorrowed, int numChannels);
+        
+        protected:
+        
+        MipmapTable*                  mTable;
+        size_t                        mPosition;
+        
       };
 
       //////////////////////////////////////////
-      /// Renderer class.
+      /// CommandQueue class.
       //////////////////////////////////////////
+  
+      /*!
+        A change to a renderer's settings, made by the audio thread at the start of output frame frame. Frames are counted
+        from the renderer's construction, and include any silence rendered after the audio source ran dry.
+      */
+  
+      struct RendererCommand{
+        enum Type{ SET_PITCH, RESET, SET_INTERPOLATOR, ADD_LOW_PASS_FILTER, CLEAR_LOW_PASS_FILTERS };
+        Type                          type;
+        uint64_t                      frame;
+        float                         start, end, glideDuration; // SET_PITCH's arguments
+        void*                         object; // The Interpolator or Filter
+      };
+  
+      /*!
+        Wait-free queue of RendererCommands from one control thread to the audio thread. It also publishes the audio thread's
+        output frame, so the control thread can time its commands. The capacity is fixed, and rounded up to a power of two.
+        Copy and assignment make an empty queue of the same capacity, at frame 0.
+      */
+  
+      class CommandQueue{
+      
+        public:
+        
+        CommandQueue(size_t minCapacity);
+        ~CommandQueue();
+        CommandQueue(const CommandQueue& other);
+        CommandQueue& operator= (const CommandQueue& other);
+        
+        // Control thread. Returns false, and queues nothing, if the queue is full.
+        bool                          push(const RendererCommand& command);
+        
+        // Audio thread. The oldest command, or 0 if there isn't one. It stays queued until pop is called.
+        const RendererCommand*        peek();
+        void                          pop();
+        
+        // The audio thread's output frame. Only the audio thread sets it, but any thread can get it.
+        uint64_t                      getFrame();
+        void                          setFrame(uint64_t frame);
+        
+        protected:
+        
+        void                          init();
+        
+        RendererCommand*              mCommands;
+        size_t                        mCapacity;
+        std::atomic<size_t>           mWritePosition; // commands pushed since the start. Only the control thread changes it
+        std::atomic<size_t>           mReadPosition; // commands popped since the start. Only the audio thread changes it
+        std::atomic<uint64_t>         mFrame;
+        
+      };
+
+      //////////////////////////////////////////
+      /// BasicRenderer class template.
+      //////////////////////////////////////////
+
+      /*!
+        The renderer, specialized at compile time. Interp is the interpolator, either one of the built-in interpolators (for
+        example HermiteInterpolator) or DynamicInterpolator to choose one at runtime. Channels is the number of channels, or 0 to
+        choose at runtime. FilterChain is the anti-aliasing filter chain: NoFilters, StaticFilterChain<SomeFilter>, or
+        DynamicFilterChain to choose at runtime.
+       
+        When everything is known at compile time, there's no virtual dispatch in the render loop and the per-frame loops
+        unroll across channels. For example:
+       
+          BasicRenderer<HermiteInterpolator, 2, StaticFilterChain<LPF12> > renderer(44100);
+       
+        Renderer is the fully runtime-configurable version.
+       
+        The setters change plain members that render reads, so they must be called from the thread that renders, or while
+        it isn't rendering. Another thread queues its changes instead, with the queue methods, such as queuePitch. The
+        changes are made by the audio thread at the start of the output frame they're queued for, and never block either
+        thread.
+      */
 
-      class Renderer{
-      friend class Interpolator;
+      template<class Interp, int Channels, class FilterChain>
+      class BasicRenderer{
         public:
         
           /*!
             Constructor
           */
 
-          Renderer(
+          BasicRenderer(
             float sampleRate,
-            int numChannels,
+            int numChannels = Channels,
             size_t sourceBufferLength = 64,
             size_t maxFramesToRender = 64
           );
         
-          /*!
-            Destructor
-          */
-          
-          ~Renderer();
+          virtual ~BasicRenderer(){}
         
           /*!
             Render samples at the current pitch. Returns the actual number of samples written to the output buffer. 
             If the AudioSource has no more data to supply, the number of frames written may be less than the number of frames requested.
-            numFramesRequested MUST NOT exceed maxFramesToRender (64 by default)
+            Any number of frames may be requested. Requests larger than maxFramesToRender (64 by default) are rendered internally
+            in chunks of maxFramesToRender frames, so maxFramesToRender only sizes the scratch buffers and never needs to match the host block size.
           */
         
           size_t                      render(SampleType* outputBuffer, size_t numFramesRequested);
@@ -93,82 +237,1315 @@ namespace RealtimeResampler {
           void                        setPitch(float start, float end, float glideDuration);
         
           /*!
-            Returns the pitch (with 1 being same pitch, 2 being double pitch, 0.5 being half pitch) of the last rendered frame.
+            Play at exactly sourceFrames source frames for every outputFrames output frames, for converting between sample
+            rates. For example, 44.1kHz to 48kHz is setFixedRatio(441, 480). The read head moves in whole steps of 1 /
+            outputFrames of a frame, so the ratio never drifts, and the output doesn't depend on how it's split into render
+            calls. The positions cycle through outputFrames phases, once the ratio is reduced, and the interpolator's weights
+            for each phase are only worked out once. Returns false, and changes nothing, if there are more than
+            MAX_FIXED_RATIO_PHASES phases, or if exact source pull is on and the ratio is above its maxPitch. Calling setPitch
+            ends fixed ratio mode. This allocates.
+          */
+        
+          bool                        setFixedRatio(unsigned int sourceFrames, unsigned int outputFrames);
+        
+          /*!
+            Returns the pitch (with 1 being same pitch, 2 being double pitch, 0.5 being half pitch) of the next frame to be rendered.
           */
         
           float                       getCurrentPitch();
         
+          /*!
+            Control thread. Queue a call to setPitch, or reset, to be made at the start of output frame frame, or at the start of
+            the next render if that's already passed. Render splits its output at the frame, so the change is sample accurate.
+            Changes must be queued in order of frame. Returns false if the queue is full (COMMAND_QUEUE_SIZE commands).
+          */
+        
+          bool                        queuePitch(float start, float end, float glideDuration, uint64_t frame = 0);
+          bool                        queueReset(uint64_t frame = 0);
+        
+          /*!
+            Any thread. The number of output frames rendered since the renderer was made, which is the frame the next render
+            starts at. Frames after the audio source ran dry count too.
+          */
+        
+          uint64_t                    getFramesRendered();
+        
           /*!
             Get the number of channels the renderer was configured with.
           */
         
           size_t                      getNumChannels();
         
+          /*!
+            Track the source read head as a 64-bit fixed-point number (32 bits of integer frame, 32 bits of fraction) instead of a double.
+            The fixed-point read head advances by an exact integer step per frame, so playback at any pitch is bit-exact and free
+            of accumulated rounding drift no matter how long it runs. Off by default.
+          */
+        
+          void                        setUseFixedPointPhase(bool useFixedPointPhase);
         
           /*!
             Set the AudioSource delegate object. This MUST be called or there will be no data to resample!
           */
         
           void                        setAudioSource(AudioSource* audioSource);
+          
+          /*!
+            Replace the interpolator, for example with a differently configured SincInterpolator. The source buffers are
+            resized to the new interpolator's support and cleared. This should not be called after the first call to render.
+          */
+        
+          void                        setInterpolator(const Interp& interpolator);
         
           /*!
-            "Manually" set the interpolator. This should not be called after the first call to rRenderer::render.
+            By default, the renderer pulls sourceBufferLength frames from the AudioSource whenever it runs low. With exact source
+            pull on, each chunk of up to maxFramesToRender output frames instead works out from the pitch ramp exactly how many
+            source frames it needs and pulls them in a single call to getSamples. That keeps the pull sizes, and the latency of a
+            live input, proportional to what's actually rendered.
+           
+            The pitch is limited to maxPitch while exact pull is on, which bounds the largest pull. See getMaxSourceFramesPerPull.
+            This allocates, so it should not be called after the first call to render.
           */
         
-          void                        setInterpolator(Interpolator* interpolator);
+          void                        setExactSourcePull(bool exactSourcePull, float maxPitch = 4);
         
           /*!
-            "Manually" set the low pass filter. This should not be called after the first call to rRenderer::render.
+            At high pitches, halve the source rate up to maxStages times with HalfBandDecimators before interpolating, so that
+            the interpolator and the anti-aliasing filters run at a fraction of the source rate and only have to deal with the
+            pitch left over. The number of stages follows the pitch: a stage is added when the pitch reaches 3.2 times the
+            current decimation factor, and removed when it drops below 1.4 times it. Changing the number of stages causes a
+            small discontinuity. When the audio source supplies decimated octaves itself (see AudioSource::getNumOctaves), the
+            stages it covers are read from it instead. Off (0 stages) by default, and only used when exact source pull is off.
+            This allocates, so it should not be called after the first call to render.
           */
         
-          void                        addLowPassFilter(Filter* filter);
+          void                        setMaxDecimationStages(int maxStages);
         
           /*!
-            Remove all low-pass filters.
+            The most frames a single call to AudioSource::getSamples will ask for.
           */
         
-          void                        clearLowPassfilters();
+          size_t                      getMaxSourceFramesPerPull();
         
-          
           /*!
             Clear the internal buffers.
           */
         
           void                        reset();
         
-          const static int            BUFFER_BACK_PADDING; //we need to copy the first bit of the next buffer on to the end of the current buffer
-          const static int            BUFFER_FRONT_PADDING; //we need to copy the last bit of the previous buffer on to the end of the current buffer
+          const static size_t         SOURCE_NOT_ENDED = (size_t)-1;
+          const static int            FIXED_POINT_FRACTION_BITS = 32; // number of fractional bits in the fixed-point read head
+          const static int64_t        FIXED_POINT_FRACTION_MASK = 0xFFFFFFFFLL;
+          const static int64_t        FIXED_POINT_ONE = (int64_t)1 << FIXED_POINT_FRACTION_BITS; // one frame, in fixed-point units
+          const static int            FILTER_RAMP_FRAMES = 32; // during a glide, how often the anti-aliasing cutoff is worked out from the pitch
+          const static int            MAX_DECIMATION_STAGES = 4;
+          const static int            MAX_PERIODIC_PHASES = 16; // the lowest steady pitch with its own fast path is 1 / MAX_PERIODIC_PHASES
+          const static int            MAX_FIXED_RATIO_PHASES = 1024;
+          const static size_t         COMMAND_QUEUE_SIZE = 64;
 
-        private:
+        protected:
         
           //                          -methods-
-          void                        calculatePitchForNextFrames(size_t numFrames);
-          void                        swapBuffersAndFillNext();
-          void                        fillSourceBuffer(Buffer* buf);
-          void                        filterBuffer(Buffer* buf);
+          virtual void                applyCommand(const RendererCommand& command);
+          size_t                      renderFrames(SampleType* outputBuffer, size_t numFramesRequested);
+          size_t                      renderChunk(SampleType* outputBuffer, size_t numFramesRequested);
+          void                        advancePitch(size_t numFrames);
+          template<typename PositionType>
+          static PositionType         rampPositionOffset(size_t frame, PositionType pitch, PositionType pitchChangePerFrame, PositionType pitchDestination, size_t rampFrames);
+          static void                 splitPosition(double position, int offset, int* index, SampleType* fraction);
+          static void                 splitPosition(int64_t position, int offset, int* index, SampleType* fraction);
+          template<typename PositionType>
+          static size_t               countInterpolationPositions(PositionType readHead, PositionType positionLimit, PositionType pitch, PositionType pitchChangePerFrame, PositionType pitchDestination, size_t rampFrames, size_t maxFrames);
+          template<typename PositionType>
+          size_t                      buildInterpolationPositions(PositionType& readHead, PositionType positionLimit, PositionType pitch, PositionType pitchChangePerFrame, PositionType pitchDestination, size_t rampFrames, size_t maxFrames, int offset, int* indexBuffer, SampleType* fractionBuffer);
+          bool                        findPeriodicRatio(int* numPhases, int* step);
+          template<typename PositionType>
+          size_t                      renderPeriodic(PositionType& readHead, PositionType positionLimit, PositionType pitch, int numPhases, int step, size_t maxFrames, int offset, SampleType* readFrame, SampleType* outputBuffer);
+          size_t                      renderFixedRatio(size_t positionLimitFrame, size_t maxFrames, int offset, SampleType* readFrame, SampleType* outputBuffer);
+          void                        fillSourceRing(size_t framesToPull);
+          bool                        borrowSource();
+          void                        writeSourceRing(size_t position, const SampleType* frames, size_t numFrames);
+          SampleType*                 getPassFrames(size_t frame, size_t& positionLimitFrame);
+          size_t                      pullSource(SampleType* outputBuffer, size_t numFrames);
+          bool                        updateDecimation();
+          void                        setDecimationStages(int stages);
+          void                        filterSource(SampleType* samples, size_t numFrames, size_t position);
+          double                      pitchAtSourcePosition(double position);
+          void                        rebaseReadHead();
+          size_t                      getReadHeadFrame();
+          int64_t                     pitchToFixedPoint(SampleType pitch);
+          void                        allocateSourceBuffers();
+          inline int                  numChannels() const { return Channels ? Channels : mNumChannels; }
         
           //                          -variables-
           int                         mNumChannels;
           float                       mSampleRate; // frames per second
           AudioSource*                mAudioSource;
-          float                       mCurrentPitch;
+          double                      mCurrentPitch; // The pitch of the next frame. In other words, the factor by which to advance the source buffer read head
           float                       mPitchDestination;
-          float                       mSecondsUntilPitchDestination;
-          Buffer                      mPitchBuffer; // The pitch at each frame. In other words, the factor by which to advance the source buffer read head
-          Buffer                      mInterpolationPositionBuffer; // The pitch at each frame. In other words, the factor by which to advance the source buffer read head
-          bool                        mBufferSwapState;
+          double                      mPitchChangePerFrame;
+          size_t                      mFramesUntilPitchDestination;
+          int64_t                     mFixedPitch; // 32.32 fixed-point equivalents of the pitch ramp, used in fixed-point mode
+          int64_t                     mFixedPitchDestination;
+          int64_t                     mFixedPitchChangePerFrame;
+          IndexBuffer                 mInterpolationIndexBuffer; // The source frame to interpolate from at each output frame, relative to the read head
+          Buffer                      mInterpolationFractionBuffer; // The fractional position between that frame and the next
           double                      mSourceBufferReadHead;
-          Buffer                      mSourceBuffer1;
-          Buffer                      mSourceBuffer2;
-          float                       mCurrentSourceBufferReadHead;
+          int64_t                     mFixedSourceBufferReadHead; // 32.32 fixed-point read head, used instead of mSourceBufferReadHead in fixed-point mode
+          bool                        mUseFixedPointPhase;
+          Interp                      mInterpolator;
+          RingBuffer                  mSourceRing; // The source frames, filtered. The read head and frame counts below index into it
+          size_t                      mSourceFramesFilled; // The position just past the last frame pulled from the audio source
+          size_t                      mSourceEnd; // The position just past the last frame the audio source supplied before running out, or SOURCE_NOT_ENDED
+          const SampleType*           mBorrowedFrames; // Frames lent by the audio source, read in place, ending at mSourceFramesFilled. 0 if there are none
+          int64_t                     mBorrowedStart; // The position of the first of them. It goes negative if the read head is rebased while they're in use
+          size_t                      mNumBorrowedFrames;
+          int                         mFrontPadding; // How far before the read head the interpolator reads
+          int                         mBackPadding; // How far after the read head the interpolator reads
+          int                         mMaxFrontPadding; // The most of any interpolator set or reserved so far. The ring and the weight
+          int                         mMaxBackPadding; // buffers are sized for these, so a queued interpolator can be swapped in
+          bool                        mExactSourcePull;
+          float                       mMaxPitch; // The pitch limit in exact source pull mode
           size_t                      mSourceBufferLength;
-          Interpolator*               mInterpolator;
           size_t                      mMaxFramesToRender;
-          Filter*                     mLPF[10];
-          int                         mLpfCount;
+          FilterChain                 mFilters;
+          HalfBandDecimator           mDecimators[MAX_DECIMATION_STAGES];
+          int                         mMaxDecimationStages;
+          int                         mDecimationStages; // The source rate is divided by 2^mDecimationStages before it reaches the ring
+          int                         mSourceOctaves; // How many of the stages the audio source supplies itself, with getOctaveSamples
+          Buffer                      mDecimationInput; // Source frames on their way through the decimators, with room for a decimator's history before them
+          Buffer                      mDecimationOutput;
+          Buffer                      mPeriodicWeights; // The interpolator's weights at each phase of a steady ratio, numTaps per phase
+          int                         mPeriodicPhases; // What mPeriodicWeights were worked out for: the number of phases, or 0 if nothing yet,
+          double                      mPeriodicFraction; // the fraction of the first phase,
+          SampleType                  mPeriodicPitch; // and the pitch the interpolator was set to
+          unsigned int                mRatioSourceFrames; // The reduced fixed ratio, or 0 when it's off
+          unsigned int                mRatioOutputFrames;
+          Buffer                      mRatioWeights; // The interpolator's weights at each phase of the fixed ratio, numTaps per phase
+          SampleType                  mRatioWeightsPitch; // The pitch the interpolator was set to when mRatioWeights were worked out, or 0 if they haven't been
+          CommandQueue                mCommands; // Changes queued by other threads, and the output frame
+
+      };
+
+      //////////////////////////////////////////
+      /// Renderer class.
+      //////////////////////////////////////////
+
+      /*!
+        The runtime-configurable renderer. The interpolator, the channel count and the anti-aliasing filters are all chosen at runtime.
+      */
 
+      class Renderer : public BasicRenderer<DynamicInterpolator, 0, DynamicFilterChain>{
+        public:
+        
+          /*!
+            Constructor
+          */
+
+          Renderer(
+            float sampleRate,
+            int numChannels,
+            size_t sourceBufferLength = 64,
+            size_t maxFramesToRender = 64
+          );
+        
+          /*!
+            Destructor
+          */
+          
+          ~Renderer();
+        
+          /*!
+            "Manually" set the interpolator. This should not be called after the first call to rRenderer::render.
+          */
+        
+          void                        setInterpolator(Interpolator* interpolator);
+        
+          /*!
+            "Manually" set the low pass filter. This should not be called after the first call to rRenderer::render.
+          */
+        
+          void                        addLowPassFilter(Filter* filter);
+        
+          /*!
+            Remove all low-pass filters.
+          */
+        
+          void                        clearLowPassfilters();
+        
+          /*!
+            Size the source buffers for interpolators that read up to leftSupport frames before each position and rightSupport
+            frames after it, for example 31 and 32 for a 64 tap SincInterpolator, so that queueInterpolator can switch to any of
+            them. The buffers are always big enough for the interpolators set so far. This allocates, and resets the renderer, so
+            it should not be called after the first call to render.
+          */
+        
+          void                        reserveInterpolatorSupport(int leftSupport, int rightSupport);
+        
+          /*!
+            Control thread. Queue a change of interpolator, a filter to add or the removal of all the filters, as with
+            queuePitch. The interpolator or filter must stay alive until it's been replaced or cleared. Nothing allocates on the
+            audio thread: the filter is initialized here, and the new interpolator takes over from the read position, reading
+            the frames already in the source buffers. They return false, and queue nothing, if the queue is full. So does
+            queueInterpolator if the interpolator is null or reads further than the buffers were sized for (see
+            reserveInterpolatorSupport), and queueLowPassFilter if the chain will already hold DynamicFilterChain::MAX_FILTERS
+            filters by the time it's added. The caller still owns anything that wasn't queued.
+          */
+        
+          bool                        queueInterpolator(Interpolator* interpolator, uint64_t frame = 0);
+          bool                        queueLowPassFilter(Filter* filter, uint64_t frame = 0);
+          bool                        queueClearLowPassFilters(uint64_t frame = 0);
+        
+        protected:
+        
+          void                        applyCommand(const RendererCommand& command);
+        
+          int                         mNumFilters; // The filters there'll be once the queued changes are made. Not used by the audio thread
+        
       };
+
+      //////////////////////////////////////////
+      /// BasicRenderer implementation
+      //////////////////////////////////////////
+  
+      template<class Interp, int Channels, class FilterChain> const size_t BasicRenderer<Interp, Channels, FilterChain>::SOURCE_NOT_ENDED;
+      template<class Interp, int Channels, class FilterChain> const int BasicRenderer<Interp, Channels, FilterChain>::FIXED_POINT_FRACTION_BITS;
+      template<class Interp, int Channels, class FilterChain> const int64_t BasicRenderer<Interp, Channels, FilterChain>::FIXED_POINT_FRACTION_MASK;
+      template<class Interp, int Channels, class FilterChain> const int64_t BasicRenderer<Interp, Channels, FilterChain>::FIXED_POINT_ONE;
+      template<class Interp, int Channels, class FilterChain> const int BasicRenderer<Interp, Channels, FilterChain>::FILTER_RAMP_FRAMES;
+      template<class Interp, int Channels, class FilterChain> const int BasicRenderer<Interp, Channels, FilterChain>::MAX_DECIMATION_STAGES;
+      template<class Interp, int Channels, class FilterChain> const int BasicRenderer<Interp, Channels, FilterChain>::MAX_PERIODIC_PHASES;
+      template<class Interp, int Channels, class FilterChain> const int BasicRenderer<Interp, Channels, FilterChain>::MAX_FIXED_RATIO_PHASES;
+      template<class Interp, int Channels, class FilterChain> const size_t BasicRenderer<Interp, Channels, FilterChain>::COMMAND_QUEUE_SIZE;
+  
+      template<class Interp, int Channels, class FilterChain>
+      BasicRenderer<Interp, Channels, FilterChain>::BasicRenderer(float sampleRate, int numChannels, size_t sourceBufferLength, size_t maxFramesToRender ) :
+        mNumChannels(numChannels),
+        mSampleRate(sampleRate),
+        mCurrentPitch(1),
+        mPitchDestination(1),
+        mPitchChangePerFrame(0),
+        mFramesUntilPitchDestination(0),
+        mFixedPitch(FIXED_POINT_ONE),
+        mFixedPitchDestination(FIXED_POINT_ONE),
+        mFixedPitchChangePerFrame(0),
+        mInterpolationIndexBuffer(maxFramesToRender),
+        mInterpolationFractionBuffer(maxFramesToRender, 1),
+        mSourceBufferReadHead(0),
+        mFixedSourceBufferReadHead(0),
+        mUseFixedPointPhase(false),
+        mSourceRing(sourceBufferLength + mInterpolator.getLeftSupport() + mInterpolator.getRightSupport(), numChannels, mInterpolator.getLeftSupport(), mInterpolator.getRightSupport()),
+        mSourceFramesFilled(0),
+        mSourceEnd(SOURCE_NOT_ENDED),
+        mBorrowedFrames(0),
+        mBorrowedStart(0),
+        mNumBorrowedFrames(0),
+        mFrontPadding(mInterpolator.getLeftSupport()),
+        mBackPadding(mInterpolator.getRightSupport()),
+        mMaxFrontPadding(mInterpolator.getLeftSupport()),
+        mMaxBackPadding(mInterpolator.getRightSupport()),
+        mExactSourcePull(false),
+        mMaxPitch(1),
+        mSourceBufferLength(sourceBufferLength),
+        mMaxFramesToRender(maxFramesToRender),
+        mMaxDecimationStages(0),
+        mDecimationStages(0),
+        mSourceOctaves(0),
+        mDecimationInput(0, numChannels),
+        mDecimationOutput(0, numChannels),
+        mPeriodicWeights(MAX_PERIODIC_PHASES * (mInterpolator.getLeftSupport() + mInterpolator.getRightSupport() + 1), 1),
+        mPeriodicPhases(0),
+        mPeriodicFraction(0),
+        mPeriodicPitch(0),
+        mRatioSourceFrames(0),
+        mRatioOutputFrames(0),
+        mRatioWeights(0, 1),
+        mRatioWeightsPitch(0),
+        mCommands(COMMAND_QUEUE_SIZE)
+      {
+        assert(Channels == 0 || numChannels == Channels);
+        mFilters.init(sampleRate, sourceBufferLength, numChannels);
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::setInterpolator(const Interp& interpolator){
+        mInterpolator = interpolator;
+        allocateSourceBuffers();
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::setExactSourcePull(bool exactSourcePull, float maxPitch){
+        mExactSourcePull = exactSourcePull;
+        mMaxPitch = std::max(1.0f, maxPitch);
+        allocateSourceBuffers();
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::setMaxDecimationStages(int maxStages){
+        mMaxDecimationStages = std::max(0, std::min(maxStages, (int)MAX_DECIMATION_STAGES));
+        allocateSourceBuffers();
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::getMaxSourceFramesPerPull(){
+        if (!mExactSourcePull) {
+          // A decimated pull is always at least one frame after decimation
+          return std::max(mSourceBufferLength, (size_t)1 << mMaxDecimationStages);
+        }
+        // A chunk's positions span at most (maxFramesToRender - 1) * maxPitch frames, plus up to a frame for the fraction of the
+        // first position, plus the step from the last frame of the previous chunk. On top of that the interpolator reads
+        // mBackPadding frames ahead of the last position, and mBackPadding is never more than mMaxBackPadding.
+        return (size_t)ceil(mMaxFramesToRender * mMaxPitch) + 1 + mMaxBackPadding;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::allocateSourceBuffers(){
+        mFrontPadding = mInterpolator.getLeftSupport();
+        mBackPadding = mInterpolator.getRightSupport();
+        mMaxFrontPadding = std::max(mMaxFrontPadding, mFrontPadding);
+        mMaxBackPadding = std::max(mMaxBackPadding, mBackPadding);
+        size_t maxPull = getMaxSourceFramesPerPull();
+        if (mExactSourcePull) {
+          // Room for the largest pull on top of the frames still needed behind the read head. A pull that wraps around the end of
+          // the ring is written past it, into the guard, in one piece, and then moved to the start.
+          mSourceRing = RingBuffer(maxPull + mMaxFrontPadding, numChannels(), mMaxFrontPadding, std::max(maxPull, (size_t)mMaxBackPadding));
+        }else{
+          // Room for a full pull from the audio source, on top of the frames still needed around the read head
+          mSourceRing = RingBuffer(maxPull + mMaxFrontPadding + mMaxBackPadding, numChannels(), mMaxFrontPadding, mMaxBackPadding);
+        }
+        if (mMaxDecimationStages > 0 && !mExactSourcePull) {
+          // Room for a pull at the full source rate, or for rebuilding the frames around the read head when the number of
+          // stages changes
+          size_t decimationFrames = std::max(maxPull, 2 * mSourceRing.getNumFrames());
+          mDecimationInput = Buffer(decimationFrames, numChannels(), HalfBandDecimator::HISTORY_FRAMES);
+          mDecimationOutput = Buffer(decimationFrames, numChannels(), HalfBandDecimator::HISTORY_FRAMES);
+          for (int stage = 0; stage < mMaxDecimationStages; stage++) {
+            mDecimators[stage].init(numChannels());
+          }
+        }else{
+          mDecimationInput = Buffer(0, numChannels());
+          mDecimationOutput = Buffer(0, numChannels());
+        }
+        mPeriodicWeights = Buffer(MAX_PERIODIC_PHASES * (mMaxFrontPadding + mMaxBackPadding + 1), 1);
+        mPeriodicPhases = 0;
+        mRatioWeights = Buffer(mRatioOutputFrames * (mMaxFrontPadding + mMaxBackPadding + 1), 1);
+        mRatioWeightsPitch = 0;
+        mFilters.init(mSampleRate, maxPull, numChannels());
+        reset();
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::reset(){
+          mSourceRing.clear();
+          mSourceFramesFilled = 0;
+          mSourceEnd = SOURCE_NOT_ENDED;
+          mBorrowedFrames = 0;
+          mNumBorrowedFrames = 0;
+          mSourceBufferReadHead = 0;
+          mFixedSourceBufferReadHead = 0;
+          mFilters.reset();
+          mDecimationStages = 0;
+          mSourceOctaves = 0;
+          for (int stage = 0; stage < mMaxDecimationStages; stage++) {
+            mDecimators[stage].reset();
+          }
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::getNumChannels(){
+        return numChannels();
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::render(SampleType* outputBuffer, size_t numFramesRequested){
+      
+        const int channels = numChannels();
+        const uint64_t firstFrame = mCommands.getFrame();
+        
+        // Make the queued changes as their frames come up, rendering the frames in between. Once the audio source runs dry
+        // the rest is silence, but the changes are still made on time.
+        size_t numFramesRendered = 0;
+        size_t position = 0;
+        bool sourceEnded = false;
+        while (position < numFramesRequested) {
+          size_t framesToRender = numFramesRequested - position;
+          while (const RendererCommand* command = mCommands.peek()) {
+            if (command->frame > firstFrame + position) {
+              framesToRender = (size_t)std::min((uint64_t)framesToRender, command->frame - (firstFrame + position));
+              break;
+            }
+            applyCommand(*command);
+            mCommands.pop();
+          }
+          if (sourceEnded) {
+            memset(outputBuffer + position * channels, 0, framesToRender * channels * sizeof(SampleType));
+          }else{
+            size_t framesRendered = renderFrames(outputBuffer + position * channels, framesToRender);
+            numFramesRendered += framesRendered;
+            sourceEnded = framesRendered < framesToRender;
+          }
+          position += framesToRender;
+        }
+        
+        mCommands.setFrame(firstFrame + numFramesRequested);
+        return numFramesRendered;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::renderFrames(SampleType* outputBuffer, size_t numFramesRequested){
+      
+        const int channels = numChannels();
+      
+        memset(outputBuffer, 0, numFramesRequested * channels * sizeof(SampleType));
+        
+        size_t numFramesRendered = 0;
+        
+        // The scratch buffers only hold mMaxFramesToRender frames, so larger requests are rendered in chunks.
+        // Stop as soon as a chunk comes back short, which means the audio source has run dry.
+        while (numFramesRendered < numFramesRequested) {
+          size_t framesToRender = std::min(numFramesRequested - numFramesRendered, mMaxFramesToRender);
+          size_t framesRendered = renderChunk(outputBuffer + numFramesRendered * channels, framesToRender);
+          numFramesRendered += framesRendered;
+          if (framesRendered < framesToRender) {
+            break;
+          }
+        }
+        
+        return numFramesRendered;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::renderChunk(SampleType* outputBuffer, size_t numFramesRequested){
+        
+        assert(numFramesRequested <= mMaxFramesToRender);
+        
+        const int channels = numChannels();
+        size_t numFramesRendered = 0;
+        
+        if (mExactSourcePull && numFramesRequested > 0) {
+          // Work out which frame the last position of the chunk falls on, and pull everything up to the last frame the
+          // interpolator will read from it.
+          rebaseReadHead();
+          size_t lastFrame;
+          if (mUseFixedPointPhase) {
+            lastFrame = (size_t)((mFixedSourceBufferReadHead + rampPositionOffset(numFramesRequested - 1, mFixedPitch, mFixedPitchChangePerFrame, mFixedPitchDestination, mFramesUntilPitchDestination)) >> FIXED_POINT_FRACTION_BITS);
+          }else{
+            lastFrame = (size_t)(mSourceBufferReadHead + rampPositionOffset(numFramesRequested - 1, mCurrentPitch, mPitchChangePerFrame, (double)mPitchDestination, mFramesUntilPitchDestination));
+          }
+          size_t framesNeeded = lastFrame + mBackPadding + 1;
+          if (framesNeeded > mSourceFramesFilled) {
+            fillSourceRing(framesNeeded - mSourceFramesFilled);
+          }
+        }
+        
+        while (numFramesRendered < numFramesRequested) {
+        
+          rebaseReadHead();
+          size_t readHeadFrame = getReadHeadFrame();
+          
+          // stop once the audio source has run dry
+          if (readHeadFrame >= mSourceEnd) {
+            reset();
+            break;
+          }
+            
+          // pull more source data if the interpolator would read past what we have. In exact pull mode the chunk's frames
+          // were pulled above, but allow for the last position of a pass rounding differently than the whole chunk.
+          if (readHeadFrame + mBackPadding >= mSourceFramesFilled) {
+            // when decimating, this is when the number of stages can change, since there are only a few frames around the read
+            // head to convert to the new rate
+            if (updateDecimation()) {
+              continue;
+            }
+            if (!borrowSource()) {
+              fillSourceRing(mExactSourcePull ? readHeadFrame + mBackPadding + 1 - mSourceFramesFilled : std::max((size_t)1, mSourceBufferLength >> mDecimationStages));
+            }
+            continue;
+          }
+        
+          // how many frames to render in this pass
+          size_t interpolatedFramesToRender = 0;
+          size_t maxFramesToInterpolate = numFramesRequested - numFramesRendered;
+      
+          // the integer part of the read head. Interpolation indices are relative to this frame.
+          int interpPositionOffset = readHeadFrame;
+          
+          // Stop the pass before the interpolator would read past the frames pulled so far, past the end of the source, or
+          // past the end of the ring (the guard after the end only mirrors mBackPadding frames).
+          size_t positionLimitFrame = std::min(std::min(mSourceFramesFilled - mBackPadding, mSourceEnd), mSourceRing.getNumFrames());
+          SampleType* readHead = getPassFrames(readHeadFrame, positionLimitFrame);
+          
+          int* indexBuffer = mInterpolationIndexBuffer.getStartPtr();
+          SampleType* fractionBuffer = mInterpolationFractionBuffer.getStartPtr();
+          
+          // the highest pitch in this pass, for band-limited interpolators. Pitch changes linearly, so it's at one end or the other.
+          double maxPitch = mCurrentPitch;
+          
+          // start where we left off
+          SampleType* writeHead = outputBuffer + numFramesRendered * channels;
+          
+          // Decimation divides the pitch the ring is read at
+          int stages = mDecimationStages;
+          double decimation = 1 << stages;
+          
+          // A fixed ratio walks its positions in whole steps, unless it's high enough to be decimating
+          if (mRatioOutputFrames && stages == 0) {
+            interpolatedFramesToRender = renderFixedRatio(positionLimitFrame, maxFramesToInterpolate, interpPositionOffset, readHead, writeHead);
+            numFramesRendered += interpolatedFramesToRender;
+            continue;
+          }
+          
+          // A steady whole number pitch, or one over a power of two, has its own fast path
+          int numPhases, step;
+          if (mFramesUntilPitchDestination == 0 && findPeriodicRatio(&numPhases, &step)) {
+            if (mUseFixedPointPhase) {
+              interpolatedFramesToRender = renderPeriodic(mFixedSourceBufferReadHead, (int64_t)positionLimitFrame << FIXED_POINT_FRACTION_BITS, mFixedPitch >> stages, numPhases, step, maxFramesToInterpolate, interpPositionOffset, readHead, writeHead);
+            }else{
+              interpolatedFramesToRender = renderPeriodic(mSourceBufferReadHead, (double)positionLimitFrame, (double)mPitchDestination / decimation, numPhases, step, maxFramesToInterpolate, interpPositionOffset, readHead, writeHead);
+            }
+            numFramesRendered += interpolatedFramesToRender;
+            continue;
+          }
+          
+          // build the interpolation position buffers straight from the pitch ramp, starting at the last position read. Never
+          // go past the position limit, or render more frames than requested.
+          if (mUseFixedPointPhase) {
+            int64_t positionLimit = (int64_t)positionLimitFrame << FIXED_POINT_FRACTION_BITS;
+            interpolatedFramesToRender = buildInterpolationPositions(mFixedSourceBufferReadHead, positionLimit, mFixedPitch >> stages, mFixedPitchChangePerFrame >> stages, mFixedPitchDestination >> stages, mFramesUntilPitchDestination, maxFramesToInterpolate, interpPositionOffset, indexBuffer, fractionBuffer);
+          }else{
+            interpolatedFramesToRender = buildInterpolationPositions(mSourceBufferReadHead, (double)positionLimitFrame, mCurrentPitch / decimation, mPitchChangePerFrame / decimation, (double)mPitchDestination / decimation, mFramesUntilPitchDestination, maxFramesToInterpolate, interpPositionOffset, indexBuffer, fractionBuffer);
+          }
+          advancePitch(interpolatedFramesToRender);
+          maxPitch = std::max(maxPitch, mCurrentPitch) / decimation;
+          
+          // render the interpolated data
+          // interpolate [interpolatedFramesToRender] frames of every channel starting at readHead, writing to writehead
+          // and using indexBuffer and fractionBuffer for frame position and interpolation coefficient. A steady pitch of 1
+          // never gets here, as it's periodic.
+          mInterpolator.setPitch(maxPitch);
+          mInterpolator.template interpolate<Channels>(readHead, writeHead, indexBuffer, fractionBuffer, interpolatedFramesToRender, channels);
+          
+      
+          // increment our total frame count
+          numFramesRendered += interpolatedFramesToRender;
+          
+        }
+        return numFramesRendered;
+        
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::setUseFixedPointPhase(bool useFixedPointPhase){
+        if (useFixedPointPhase == mUseFixedPointPhase) {
+          return;
+        }
+        // carry the read head over to the new representation
+        if (useFixedPointPhase) {
+          mFixedSourceBufferReadHead = (int64_t)(mSourceBufferReadHead * FIXED_POINT_ONE + 0.5);
+        }else{
+          mSourceBufferReadHead = (double)mFixedSourceBufferReadHead / FIXED_POINT_ONE;
+        }
+        mUseFixedPointPhase = useFixedPointPhase;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::getReadHeadFrame(){
+        if (mUseFixedPointPhase) {
+          return (size_t)(mFixedSourceBufferReadHead >> FIXED_POINT_FRACTION_BITS);
+        }
+        return (size_t)mSourceBufferReadHead;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      int64_t BasicRenderer<Interp, Channels, FilterChain>::pitchToFixedPoint(SampleType pitch){
+        return (int64_t)(pitch * (double)FIXED_POINT_ONE + 0.5);
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::setAudioSource(AudioSource* audioSource){
+        mAudioSource = audioSource;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::setPitch(float start, float end, float glideDuration){
+          if (mExactSourcePull) {
+            start = std::min(start, mMaxPitch);
+            end = std::min(end, mMaxPitch);
+          }
+          mRatioSourceFrames = 0;
+          mRatioOutputFrames = 0;
+          mCurrentPitch = start;
+          mPitchDestination = end;
+          mFramesUntilPitchDestination = glideDuration > 0 ? std::max((size_t)1, (size_t)(glideDuration * mSampleRate + 0.5)) : 0;
+          if (mFramesUntilPitchDestination > 0) {
+            mPitchChangePerFrame = ((double)end - start) / mFramesUntilPitchDestination;
+          }else{
+            mCurrentPitch = end;
+            mPitchChangePerFrame = 0;
+          }
+          mFixedPitch = pitchToFixedPoint(mCurrentPitch);
+          mFixedPitchDestination = pitchToFixedPoint(end);
+          mFixedPitchChangePerFrame = (int64_t)floor(mPitchChangePerFrame * FIXED_POINT_ONE + 0.5);
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      bool BasicRenderer<Interp, Channels, FilterChain>::setFixedRatio(unsigned int sourceFrames, unsigned int outputFrames){
+        assert(sourceFrames > 0 && outputFrames > 0);
+        unsigned int a = sourceFrames, b = outputFrames;
+        while (b != 0) {
+          unsigned int remainder = a % b;
+          a = b;
+          b = remainder;
+        }
+        sourceFrames /= a;
+        outputFrames /= a;
+        if (outputFrames > MAX_FIXED_RATIO_PHASES) {
+          return false;
+        }
+        // Exact pull sizes its pulls, and the ring, for pitches up to mMaxPitch
+        if (mExactSourcePull && sourceFrames > (double)mMaxPitch * outputFrames) {
+          return false;
+        }
+        setPitch((float)sourceFrames / outputFrames, (float)sourceFrames / outputFrames, 0);
+        mCurrentPitch = (double)sourceFrames / outputFrames;
+        mFixedPitch = mFixedPitchDestination = (int64_t)(((uint64_t)sourceFrames << FIXED_POINT_FRACTION_BITS) / outputFrames);
+        mRatioSourceFrames = sourceFrames;
+        mRatioOutputFrames = outputFrames;
+        mRatioWeights = Buffer(outputFrames * (mMaxFrontPadding + mMaxBackPadding + 1), 1);
+        mRatioWeightsPitch = 0;
+        return true;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      float BasicRenderer<Interp, Channels, FilterChain>::getCurrentPitch(){
+        return mCurrentPitch;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      bool BasicRenderer<Interp, Channels, FilterChain>::queuePitch(float start, float end, float glideDuration, uint64_t frame){
+        RendererCommand command = RendererCommand();
+        command.type = RendererCommand::SET_PITCH;
+        command.frame = frame;
+        command.start = start;
+        command.end = end;
+        command.glideDuration = glideDuration;
+        return mCommands.push(command);
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      bool BasicRenderer<Interp, Channels, FilterChain>::queueReset(uint64_t frame){
+        RendererCommand command = RendererCommand();
+        command.type = RendererCommand::RESET;
+        command.frame = frame;
+        return mCommands.push(command);
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      uint64_t BasicRenderer<Interp, Channels, FilterChain>::getFramesRendered(){
+        return mCommands.getFrame();
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::applyCommand(const RendererCommand& command){
+        switch (command.type) {
+          case RendererCommand::SET_PITCH:
+            setPitch(command.start, command.end, command.glideDuration);
+            break;
+          case RendererCommand::RESET:
+            reset();
+            break;
+          default:
+            // the rest are Renderer's
+            break;
+        }
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::advancePitch(size_t numFrames){
+        if (numFrames < mFramesUntilPitchDestination) {
+          mCurrentPitch += numFrames * mPitchChangePerFrame;
+          mFixedPitch += (int64_t)numFrames * mFixedPitchChangePerFrame;
+          mFramesUntilPitchDestination -= numFrames;
+        }else{
+          mCurrentPitch = mPitchDestination;
+          mFixedPitch = mFixedPitchDestination;
+          mPitchChangePerFrame = 0;
+          mFixedPitchChangePerFrame = 0;
+          mFramesUntilPitchDestination = 0;
+        }
+      }
+  
+      //////////////////////////////////////////
+      /// Interpolation position generation
+      //////////////////////////////////////////
+  
+      /*
+        The pitch of frame n of a glide is pitch + n * pitchChangePerFrame until the destination is reached after rampFrames frames,
+        so the read head position of frame n is a closed-form arithmetic series. That lets us compute every position independently
+        rather than accumulating them frame by frame, which keeps the loops free of dependencies (and vectorizable), and keeps
+        rounding error from accumulating in the floating-point case. The same code runs on doubles and on 32.32 fixed-point integers,
+        where it is exact.
+      */
+  
+      template<class Interp, int Channels, class FilterChain>
+      template<typename PositionType>
+      PositionType BasicRenderer<Interp, Channels, FilterChain>::rampPositionOffset(size_t frame, PositionType pitch, PositionType pitchChangePerFrame, PositionType pitchDestination, size_t rampFrames){
+        if (frame <= rampFrames) {
+          return (PositionType)frame * pitch + pitchChangePerFrame * (PositionType)(frame * (frame - 1) / 2);
+        }
+        return (PositionType)rampFrames * pitch + pitchChangePerFrame * (PositionType)(rampFrames * (rampFrames - 1) / 2) + (PositionType)(frame - rampFrames) * pitchDestination;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::splitPosition(double position, int offset, int* index, SampleType* fraction){
+        int frame = (int)position;
+        *index = frame - offset;
+        *fraction = position - frame;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::splitPosition(int64_t position, int offset, int* index, SampleType* fraction){
+        *index = (int)(position >> FIXED_POINT_FRACTION_BITS) - offset;
+        // Only the top 24 bits of the fraction fit in a float without rounding up to 1
+        *fraction = (SampleType)((position & FIXED_POINT_FRACTION_MASK) >> 8) * (1.0f / (1 << 24));
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      template<typename PositionType>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::countInterpolationPositions(PositionType readHead, PositionType positionLimit, PositionType pitch, PositionType pitchChangePerFrame, PositionType pitchDestination, size_t rampFrames, size_t maxFrames){
+        // Positions only move forward, so binary search for the first one that falls outside the source buffer.
+        size_t low = 0;
+        size_t high = maxFrames;
+        while (low < high) {
+          size_t mid = (low + high) / 2;
+          if (readHead + rampPositionOffset(mid, pitch, pitchChangePerFrame, pitchDestination, rampFrames) < positionLimit) {
+            low = mid + 1;
+          }else{
+            high = mid;
+          }
+        }
+        return low;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      template<typename PositionType>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::buildInterpolationPositions(PositionType& readHead, PositionType positionLimit, PositionType pitch, PositionType pitchChangePerFrame, PositionType pitchDestination, size_t rampFrames, size_t maxFrames, int offset, int* indexBuffer, SampleType* fractionBuffer){
+        
+        size_t numFrames = countInterpolationPositions(readHead, positionLimit, pitch, pitchChangePerFrame, pitchDestination, rampFrames, maxFrames);
+        
+        size_t numRampFrames = std::min(numFrames, rampFrames);
+        for (size_t frame = 0; frame < numRampFrames; frame++) {
+          PositionType position = readHead + (PositionType)frame * pitch + pitchChangePerFrame * (PositionType)(frame * (frame - 1) / 2);
+          splitPosition(position, offset, indexBuffer + frame, fractionBuffer + frame);
+        }
+        PositionType rampEnd = readHead + rampPositionOffset(numRampFrames, pitch, pitchChangePerFrame, pitchDestination, rampFrames);
+        for (size_t frame = numRampFrames; frame < numFrames; frame++) {
+          PositionType position = rampEnd + (PositionType)(frame - numRampFrames) * pitchDestination;
+          splitPosition(position, offset, indexBuffer + frame, fractionBuffer + frame);
+        }
+        
+        readHead += rampPositionOffset(numFrames, pitch, pitchChangePerFrame, pitchDestination, rampFrames);
+        return numFrames;
+      }
+  
+      /*
+        At a steady pitch of N, every position has the same fraction, and N frames separate each one from the next. At 1 / N,
+        the fractions cycle through N values, and the frame moves on by one each cycle. Either way the interpolator's weights
+        only need working out once per phase, rather than once per frame, and the positions needn't be built at all. A phase
+        that lands on a whole frame is a straight copy. The output is the same as the general path's, give or take rounding,
+        so moving in and out of a steady ratio is seamless.
+      */
+  
+      template<class Interp, int Channels, class FilterChain>
+      bool BasicRenderer<Interp, Channels, FilterChain>::findPeriodicRatio(int* numPhases, int* step){
+        const int stages = mDecimationStages;
+        if (mUseFixedPointPhase) {
+          int64_t pitch = mFixedPitch >> stages;
+          if (pitch <= 0) {
+            return false;
+          }
+          if ((pitch & FIXED_POINT_FRACTION_MASK) == 0) {
+            *numPhases = 1;
+            *step = (int)(pitch >> FIXED_POINT_FRACTION_BITS);
+            return true;
+          }
+          if (pitch < FIXED_POINT_ONE && FIXED_POINT_ONE % pitch == 0 && FIXED_POINT_ONE / pitch <= MAX_PERIODIC_PHASES) {
+            *numPhases = (int)(FIXED_POINT_ONE / pitch);
+            *step = 1;
+            return true;
+          }
+          return false;
+        }
+        double pitch = (double)mPitchDestination / (1 << stages);
+        if (pitch <= 0) {
+          return false;
+        }
+        if (pitch >= 1 && pitch == floor(pitch) && pitch <= INT_MAX) {
+          *numPhases = 1;
+          *step = (int)pitch;
+          return true;
+        }
+        double phases = 1 / pitch;
+        if (pitch < 1 && phases <= MAX_PERIODIC_PHASES && phases == floor(phases) && phases * pitch == 1) {
+          *numPhases = (int)phases;
+          *step = 1;
+          return true;
+        }
+        return false;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      template<typename PositionType>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::renderPeriodic(PositionType& readHead, PositionType positionLimit, PositionType pitch, int numPhases, int step, size_t maxFrames, int offset, SampleType* readFrame, SampleType* outputBuffer){
+      
+        const int channels = numChannels();
+        const int numTaps = mFrontPadding + mBackPadding + 1;
+        size_t numFrames = countInterpolationPositions(readHead, positionLimit, pitch, (PositionType)0, pitch, 0, maxFrames);
+        
+        int phaseIndex[MAX_PERIODIC_PHASES] = { 0 };
+        SampleType phaseFraction[MAX_PERIODIC_PHASES] = { 0 };
+        for (int phase = 0; phase < numPhases; phase++) {
+          splitPosition(readHead + (PositionType)phase * pitch, offset, phaseIndex + phase, phaseFraction + phase);
+        }
+        readHead += (PositionType)numFrames * pitch;
+        
+        // At pitch 1 on a whole frame there's nothing to interpolate
+        if (numPhases == 1 && step == 1 && phaseFraction[0] == 0) {
+          memcpy(outputBuffer, readFrame + phaseIndex[0] * channels, numFrames * channels * sizeof(SampleType));
+          return numFrames;
+        }
+        
+        // Work out the weights for each phase, unless they're the ones worked out last time
+        SampleType interpolatorPitch = mCurrentPitch / (1 << mDecimationStages);
+        mInterpolator.setPitch(interpolatorPitch);
+        SampleType* weights = mPeriodicWeights.getStartPtr();
+        if (numPhases != mPeriodicPhases || phaseFraction[0] != mPeriodicFraction || interpolatorPitch != mPeriodicPitch) {
+          for (int phase = 0; phase < numPhases; phase++) {
+            if (!mInterpolator.kernelWeights(phaseFraction[phase], weights + phase * numTaps)) {
+              // the interpolator can't be described by its weights, so build the positions after all
+              int* indexBuffer = mInterpolationIndexBuffer.getStartPtr();
+              SampleType* fractionBuffer = mInterpolationFractionBuffer.getStartPtr();
+              for (size_t frame = 0; frame < numFrames; frame++) {
+                indexBuffer[frame] = phaseIndex[frame % numPhases] + (int)(frame / numPhases) * step;
+                fractionBuffer[frame] = phaseFraction[frame % numPhases];
+              }
+              mInterpolator.template interpolate<Channels>(readFrame, outputBuffer, indexBuffer, fractionBuffer, numFrames, channels);
+              return numFrames;
+            }
+          }
+          mPeriodicPhases = numPhases;
+          mPeriodicFraction = phaseFraction[0];
+          mPeriodicPitch = interpolatorPitch;
+        }
+        
+        if (Channels == 0 && channels == 2) {
+          interpolatePeriodic<2>(readFrame, outputBuffer, phaseIndex, weights, numTaps, -mFrontPadding, numPhases, step, numFrames, 2);
+        }else{
+          interpolatePeriodic<Channels>(readFrame, outputBuffer, phaseIndex, weights, numTaps, -mFrontPadding, numPhases, step, numFrames, channels);
+        }
+        return numFrames;
+      }
+  
+      /*
+        In fixed ratio mode the read head is always a whole number of steps of 1 / L of a frame, for a ratio of M / L. It's kept
+        in the usual read head, and recovered exactly by rounding, so nothing else needs to know about the mode. Positions are
+        counted in steps: output frame i is at the read head plus i * M steps, and its phase is that position modulo L.
+      */
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::renderFixedRatio(size_t positionLimitFrame, size_t maxFrames, int offset, SampleType* readFrame, SampleType* outputBuffer){
+      
+        const int channels = numChannels();
+        const int numTaps = mFrontPadding + mBackPadding + 1;
+        const uint64_t sourceSteps = mRatioSourceFrames;
+        const uint64_t outputSteps = mRatioOutputFrames;
+        
+        // the read head in steps, rounded onto the nearest one in case it was moved some other way
+        uint64_t readHeadFrame = getReadHeadFrame();
+        double fraction = mUseFixedPointPhase ? (double)(mFixedSourceBufferReadHead & FIXED_POINT_FRACTION_MASK) / FIXED_POINT_ONE : mSourceBufferReadHead - (double)readHeadFrame;
+        uint64_t position = readHeadFrame * outputSteps + (uint64_t)(fraction * outputSteps + 0.5);
+        
+        // the frames whose positions fall before the limit
+        uint64_t limit = (uint64_t)positionLimitFrame * outputSteps;
+        size_t numFrames = position < limit ? (size_t)std::min((uint64_t)maxFrames, (limit - position + sourceSteps - 1) / sourceSteps) : 0;
+        
+        int firstIndex = (int)(position / outputSteps) - offset;
+        int firstPhase = (int)(position % outputSteps);
+        
+        // move the read head on
+        position += numFrames * sourceSteps;
+        uint64_t frame = position / outputSteps;
+        uint64_t step = position % outputSteps;
+        mSourceBufferReadHead = (double)frame + (double)step / outputSteps;
+        mFixedSourceBufferReadHead = ((int64_t)frame << FIXED_POINT_FRACTION_BITS) + (int64_t)((step << FIXED_POINT_FRACTION_BITS) / outputSteps);
+        
+        SampleType interpolatorPitch = mCurrentPitch;
+        mInterpolator.setPitch(interpolatorPitch);
+        
+        // work out the weights of every phase the first time through
+        SampleType* weights = mRatioWeights.getStartPtr();
+        bool haveWeights = interpolatorPitch == mRatioWeightsPitch;
+        if (!haveWeights) {
+          haveWeights = true;
+          for (uint64_t row = 0; row < outputSteps && haveWeights; row++) {
+            haveWeights = mInterpolator.kernelWeights((SampleType)row / (SampleType)outputSteps, weights + row * numTaps);
+          }
+          mRatioWeightsPitch = haveWeights ? interpolatorPitch : 0;
+        }
+        
+        if (!haveWeights) {
+          // the interpolator can't be described by its weights, so build the positions from the steps
+          int* indexBuffer = mInterpolationIndexBuffer.getStartPtr();
+          SampleType* fractionBuffer = mInterpolationFractionBuffer.getStartPtr();
+          int index = firstIndex;
+          int phase = firstPhase;
+          for (size_t i = 0; i < numFrames; i++) {
+            indexBuffer[i] = index;
+            fractionBuffer[i] = (SampleType)phase / (SampleType)outputSteps;
+            index += (int)(sourceSteps / outputSteps);
+            phase += (int)(sourceSteps % outputSteps);
+            if (phase >= (int)outputSteps) {
+              phase -= (int)outputSteps;
+              index++;
+            }
+          }
+          mInterpolator.template interpolate<Channels>(readFrame, outputBuffer, indexBuffer, fractionBuffer, numFrames, channels);
+        }else if (Channels == 0 && channels == 2) {
+          interpolateFixedRatio<2>(readFrame, outputBuffer, firstIndex, firstPhase, (int)sourceSteps, (int)outputSteps, weights, numTaps, -mFrontPadding, numFrames, 2);
+        }else{
+          interpolateFixedRatio<Channels>(readFrame, outputBuffer, firstIndex, firstPhase, (int)sourceSteps, (int)outputSteps, weights, numTaps, -mFrontPadding, numFrames, channels);
+        }
+        return numFrames;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::fillSourceRing(size_t framesToPull){
+      
+        const int channels = numChannels();
+        
+        // Pull framesToPull frames into the ring after the frames we already have. In exact pull mode that's always a single call
+        // to the audio source, since the guard after the ring is big enough to take the part of the pull that wraps. Otherwise it
+        // takes two calls if the frames wrap around the end of the ring.
+        while (framesToPull > 0) {
+          size_t ringFrame = mSourceFramesFilled & (mSourceRing.getNumFrames() - 1);
+          size_t framesToWrite = mExactSourcePull ? framesToPull : std::min(framesToPull, mSourceRing.getNumFrames() - ringFrame);
+          SampleType* writeHead = mSourceRing.getFramePtr(ringFrame);
+          size_t framesWritten = 0;
+          if (mSourceEnd == SOURCE_NOT_ENDED) {
+            framesWritten = pullSource(writeHead, framesToWrite);
+            // run the new frames through the anti-aliasing filter
+            filterSource(writeHead, framesWritten, mSourceFramesFilled);
+            if (framesWritten < framesToWrite) {
+              mSourceEnd = mSourceFramesFilled + framesWritten;
+            }
+          }
+          // zero out the rest in case the audio source came up short
+          memset(writeHead + framesWritten * channels, 0, (framesToWrite - framesWritten) * channels * sizeof(SampleType));
+          mSourceRing.mirror(ringFrame, framesToWrite);
+          mSourceFramesFilled += framesToWrite;
+          framesToPull -= framesToWrite;
+        }
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      bool BasicRenderer<Interp, Channels, FilterChain>::borrowSource(){
+      
+        // The interpolator reads across the join between what's borrowed and what comes before or after it, so the ring keeps
+        // copies of that many frames at each end. Those around the read head are the only ones it reads from the ring. Enough
+        // are kept for any interpolator that might be swapped in while the frames are borrowed.
+        const size_t joinFrames = mMaxFrontPadding + mMaxBackPadding;
+        
+        // The frames borrowed last time are only good until the source is called again, so copy the end of them first
+        if (mBorrowedFrames) {
+          size_t tailFrames = std::min(joinFrames, mNumBorrowedFrames);
+          writeSourceRing(mSourceFramesFilled - tailFrames, mBorrowedFrames + (mNumBorrowedFrames - tailFrames) * numChannels(), tailFrames);
+          mBorrowedFrames = 0;
+          mNumBorrowedFrames = 0;
+        }
+        
+        // Borrowed frames can't be filtered or decimated in place, so only borrow while they won't need to be. Exact pull has
+        // its own pull sizes, and the ring has to be big enough for the copies at both ends.
+        bool filtering = !mFilters.isEmpty() && (mCurrentPitch > 1 || mPitchDestination > 1);
+        if (filtering || mMaxDecimationStages > 0 || mExactSourcePull || mSourceEnd != SOURCE_NOT_ENDED || mSourceRing.getNumFrames() < 2 * joinFrames) {
+          return false;
+        }
+        
+        // With filters, borrow no more than a normal pull, so a pitch change that needs them takes effect as soon as it would
+        // have anyway
+        size_t maxFrames = mFilters.isEmpty() ? (size_t)INT_MAX : mSourceBufferLength;
+        size_t numFrames = 0;
+        const SampleType* frames = mAudioSource->borrowSamples(maxFrames, &numFrames, numChannels());
+        if (!frames || numFrames == 0) {
+          return false;
+        }
+        mBorrowedFrames = frames;
+        mBorrowedStart = (int64_t)mSourceFramesFilled;
+        mNumBorrowedFrames = numFrames;
+        writeSourceRing(mSourceFramesFilled, frames, std::min(joinFrames, numFrames));
+        mSourceFramesFilled += numFrames;
+        return true;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::writeSourceRing(size_t position, const SampleType* frames, size_t numFrames){
+        // in two pieces if they wrap around the end of the ring
+        const int channels = numChannels();
+        size_t ringFrames = mSourceRing.getNumFrames();
+        size_t ringFrame = position & (ringFrames - 1);
+        size_t firstPiece = std::min(numFrames, ringFrames - ringFrame);
+        memcpy(mSourceRing.getFramePtr(ringFrame), frames, firstPiece * channels * sizeof(SampleType));
+        mSourceRing.mirror(ringFrame, firstPiece);
+        if (numFrames > firstPiece) {
+          memcpy(mSourceRing.getFramePtr(0), frames + firstPiece * channels, (numFrames - firstPiece) * channels * sizeof(SampleType));
+          mSourceRing.mirror(0, numFrames - firstPiece);
+        }
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      SampleType* BasicRenderer<Interp, Channels, FilterChain>::getPassFrames(size_t frame, size_t& positionLimitFrame){
+        // A pass starting at frame reads the borrowed frames in place once everything the interpolator reads is inside them,
+        // and otherwise reads the ring, which only has the borrowed frames at the start of them. The interpolator doesn't
+        // write to what it reads.
+        if (!mBorrowedFrames) {
+          return mSourceRing.getFramePtr(frame);
+        }
+        int64_t firstInPlace = mBorrowedStart + mFrontPadding;
+        if ((int64_t)frame >= firstInPlace) {
+          positionLimitFrame = std::min(mSourceFramesFilled - mBackPadding, mSourceEnd);
+          return const_cast<SampleType*>(mBorrowedFrames) + ((int64_t)frame - mBorrowedStart) * numChannels();
+        }
+        int64_t ringEnd = mBorrowedStart + (int64_t)std::min((size_t)(mMaxFrontPadding + mMaxBackPadding), mNumBorrowedFrames);
+        positionLimitFrame = std::min(positionLimitFrame, (size_t)(ringEnd - mBackPadding));
+        return mSourceRing.getFramePtr(frame);
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      size_t BasicRenderer<Interp, Channels, FilterChain>::pullSource(SampleType* outputBuffer, size_t numFrames){
+      
+        const int channels = numChannels();
+        const int stages = mDecimationStages;
+        
+        if (stages == 0) {
+          return mAudioSource->getSamples(outputBuffer, numFrames, channels);
+        }
+        
+        // The audio source supplies the first mSourceOctaves stages itself
+        const int octaves = mSourceOctaves;
+        if (octaves == stages) {
+          return mAudioSource->getOctaveSamples(outputBuffer, numFrames, channels, octaves);
+        }
+        
+        // Pull 2^(stages - octaves) of the source's frames for every frame wanted, and halve the rate once per remaining stage
+        const int remainingStages = stages - octaves;
+        size_t sourceFrames = numFrames << remainingStages;
+        SampleType* input = mDecimationInput.getStartPtr();
+        SampleType* output = mDecimationOutput.getStartPtr();
+        size_t framesSupplied = octaves ? mAudioSource->getOctaveSamples(input, sourceFrames, channels, octaves) : mAudioSource->getSamples(input, sourceFrames, channels);
+        // if the source came up short, flush what it did supply out of the decimators with silence
+        memset(input + framesSupplied * channels, 0, (sourceFrames - framesSupplied) * channels * sizeof(SampleType));
+        for (int stage = octaves; stage < stages; stage++) {
+          mDecimators[stage].process(input, sourceFrames >> (stage - octaves), stage == stages - 1 ? outputBuffer : output);
+          std::swap(input, output);
+        }
+        
+        if (framesSupplied == sourceFrames) {
+          return numFrames;
+        }
+        // the frames that carry some of what was supplied, allowing for the delay through the decimators
+        size_t latency = HalfBandDecimator::DELAY * (((size_t)1 << remainingStages) - 1);
+        return std::min(numFrames, (framesSupplied + latency + ((size_t)1 << remainingStages) - 1) >> remainingStages);
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      bool BasicRenderer<Interp, Channels, FilterChain>::updateDecimation(){
+      
+        // A stage is added once the pitch left over after it would be at least DECIMATION_ADD_PITCH, and removed once the pitch
+        // left over drops below DECIMATION_REMOVE_PITCH. The gap keeps the stages from flickering on and off.
+        static const double DECIMATION_ADD_PITCH = 1.6;
+        static const double DECIMATION_REMOVE_PITCH = 1.4;
+        
+        if (mMaxDecimationStages == 0 || mExactSourcePull || mSourceEnd != SOURCE_NOT_ENDED) {
+          return false;
+        }
+        // the lowest pitch the next pull will be read at. Pitch changes linearly, so it's at one end or the other.
+        size_t pullFrames = std::max((size_t)1, mSourceBufferLength >> mDecimationStages);
+        double pitch = std::min(pitchAtSourcePosition((double)mSourceFramesFilled), pitchAtSourcePosition((double)(mSourceFramesFilled + pullFrames)));
+        double decimation = 1 << mDecimationStages;
+        if (mDecimationStages < mMaxDecimationStages && pitch >= 2 * decimation * DECIMATION_ADD_PITCH) {
+          setDecimationStages(mDecimationStages + 1);
+          return true;
+        }
+        if (mDecimationStages > 0 && pitch < decimation * DECIMATION_REMOVE_PITCH) {
+          setDecimationStages(mDecimationStages - 1);
+          return true;
+        }
+        return false;
+      }
+  
+      /*
+        Changing the number of decimation stages changes the rate of the frames in the ring. The frames around the read head are
+        rebuilt at the new rate, and the read head is moved so that it stays at the same point in the source, allowing for the
+        change in delay through the decimators. Measured in source frames, ring position p is at source time p * oldDecimation.
+        
+        When a stage is added, its input is the ring as it was, so running it over the frames before the end of the ring rebuilds
+        them exactly and fills its history. When one is removed, its history holds the most recent frames at the new rate, and
+        anything older is interpolated from the ring. Stages the audio source supplies itself are rebuilt from its history
+        instead. The source can take on a new stage only if every stage before it is its own too.
+      */
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::setDecimationStages(int stages){
+      
+        assert(stages == mDecimationStages + 1 || stages == mDecimationStages - 1);
+        
+        const int channels = numChannels();
+        const size_t ringFrames = mSourceRing.getNumFrames();
+        const size_t historyFrames = HalfBandDecimator::HISTORY_FRAMES;
+        double oldDecimation = 1 << mDecimationStages;
+        double newDecimation = 1 << stages;
+        double oldLatency = HalfBandDecimator::DELAY * (oldDecimation - 1);
+        double newLatency = HalfBandDecimator::DELAY * (newDecimation - 1);
+        size_t filled = mSourceFramesFilled;
+        double readHead = mUseFixedPointPhase ? (double)mFixedSourceBufferReadHead / FIXED_POINT_ONE : mSourceBufferReadHead;
+        
+        // The last frame in the ring is oldLatency source frames behind the last source frame pulled. The first frame the new
+        // stages make will be newDecimation source frames after that, and newLatency behind.
+        double nextTime = ((double)filled - 1) * oldDecimation + oldLatency + newDecimation - newLatency;
+        
+        // Keep the same frame count, unless that would leave no room for the frames before the read head
+        size_t newFilled = filled;
+        double newReadHead = (double)newFilled - (nextTime - readHead * oldDecimation) / newDecimation;
+        if (newReadHead < mFrontPadding + 1) {
+          newFilled += ringFrames;
+          newReadHead += ringFrames;
+        }
+        double origin = nextTime - (double)newFilled * newDecimation; // the source time of position zero at the new rate
+        
+        // the frames to rebuild, from just before the read head to the end
+        size_t firstFrame = std::min((size_t)newReadHead - mFrontPadding, newFilled);
+        size_t numFrames = std::min(newFilled - firstFrame, ringFrames);
+        firstFrame = newFilled - numFrames;
+        SampleType* frames = mDecimationOutput.getStartPtr();
+        
+        if (stages > mDecimationStages && mSourceOctaves == mDecimationStages && mAudioSource->getNumOctaves() >= stages) {
+          // the source can supply the new stage
+          mAudioSource->getOctaveHistory(frames, numFrames, channels, stages);
+          mSourceOctaves = stages;
+        }else if (stages < mSourceOctaves) {
+          // the stage going away was the source's, which can supply the frames without it as well
+          mAudioSource->getOctaveHistory(frames, numFrames, channels, stages);
+          mSourceOctaves = stages;
+        }else if (stages > mDecimationStages) {
+          // run the new stage over the end of the ring. A few extra outputs let it settle.
+          size_t numOutputs = std::min(numFrames + HalfBandDecimator::DELAY, ringFrames / 2);
+          numFrames = std::min(numFrames, numOutputs);
+          SampleType* input = mDecimationInput.getStartPtr();
+          for (size_t i = 0; i < 2 * numOutputs; i++) {
+            memcpy(input + i * channels, mSourceRing.getFramePtr(filled - 2 * numOutputs + i), channels * sizeof(SampleType));
+          }
+          HalfBandDecimator& decimator = mDecimators[mDecimationStages];
+          decimator.reset();
+          decimator.process(input, 2 * numOutputs, frames);
+          frames += (numOutputs - numFrames) * channels;
+        }else{
+          const SampleType* history = mDecimators[stages].getHistory();
+          for (size_t i = 0; i < numFrames; i++) {
+            size_t age = numFrames - 1 - i;
+            SampleType* frame = frames + i * channels;
+            if (age < historyFrames) {
+              memcpy(frame, history + (historyFrames - 1 - age) * channels, channels * sizeof(SampleType));
+            }else{
+              double oldPosition = (origin + (double)(firstFrame + i) * newDecimation) / oldDecimation;
+              double whole = floor(oldPosition);
+              SampleType fraction = oldPosition - whole;
+              const SampleType* before = mSourceRing.getFramePtr((size_t)(int64_t)whole);
+              const SampleType* after = mSourceRing.getFramePtr((size_t)(int64_t)whole + 1);
+              for (int chan = 0; chan < channels; chan++) {
+                frame[chan] = before[chan] + fraction * (after[chan] - before[chan]);
+              }
+            }
+          }
+          mDecimators[stages].reset();
+        }
+        
+        // write the rebuilt frames into the ring
+        writeSourceRing(newFilled - numFrames, frames, numFrames);
+        
+        mSourceFramesFilled = newFilled;
+        mSourceBufferReadHead = newReadHead;
+        mFixedSourceBufferReadHead = (int64_t)(newReadHead * FIXED_POINT_ONE + 0.5);
+        mDecimationStages = stages;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::filterSource(SampleType* samples, size_t numFrames, size_t position){
+        // Attenuate frequencies above nyquist, at the pitch the frames will be read at. There's no need to anti-alias if we're
+        // pitching down.
+        // The frames are decimated, so they're read at a fraction of the pitch.
+        double decimation = 1 << mDecimationStages;
+        if (mFramesUntilPitchDestination == 0) {
+          if(mCurrentPitch > decimation){
+            mFilters.process(samples, numFrames, mCurrentPitch / decimation, mCurrentPitch / decimation);
+          }
+          return;
+        }
+        // During a glide, work out the pitch every FILTER_RAMP_FRAMES frames, and let the filters move their cutoffs linearly in
+        // between. Each run of frames starts from the pitch at the frame before it.
+        const int channels = numChannels();
+        double startPitch = pitchAtSourcePosition((double)position - 1) / decimation;
+        for (size_t frame = 0; frame < numFrames; frame += FILTER_RAMP_FRAMES) {
+          size_t framesToFilter = std::min((size_t)FILTER_RAMP_FRAMES, numFrames - frame);
+          double endPitch = pitchAtSourcePosition((double)(position + frame + framesToFilter - 1)) / decimation;
+          if (startPitch > 1 || endPitch > 1) {
+            mFilters.process(samples + frame * channels, framesToFilter, startPitch, endPitch);
+          }
+          startPitch = endPitch;
+        }
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      double BasicRenderer<Interp, Channels, FilterChain>::pitchAtSourcePosition(double position){
+        // The pitch the read head will be moving at when it reaches position, following the current glide. The distance is
+        // in source frames, before decimation.
+        double readHead = mUseFixedPointPhase ? (double)mFixedSourceBufferReadHead / FIXED_POINT_ONE : mSourceBufferReadHead;
+        double distance = (position - readHead) * (1 << mDecimationStages);
+        if (distance <= 0 || mFramesUntilPitchDestination == 0) {
+          return mCurrentPitch;
+        }
+        if (distance >= rampPositionOffset(mFramesUntilPitchDestination, mCurrentPitch, mPitchChangePerFrame, (double)mPitchDestination, mFramesUntilPitchDestination)) {
+          return mPitchDestination;
+        }
+        // The read head covers distance after n frames, where c/2 n^2 + (pitch - c/2) n = distance and c is the pitch change per
+        // frame. Solve for n in the form that stays accurate when c is tiny.
+        double b = mCurrentPitch - 0.5 * mPitchChangePerFrame;
+        double denominator = b + sqrt(std::max(0.0, b * b + 2 * mPitchChangePerFrame * distance));
+        if (denominator <= 0) {
+          return mPitchDestination;
+        }
+        return mCurrentPitch + mPitchChangePerFrame * 2 * distance / denominator;
+      }
+  
+      template<class Interp, int Channels, class FilterChain>
+      void BasicRenderer<Interp, Channels, FilterChain>::rebaseReadHead(){
+        // Keep the read head inside the ring, so positions stay small and a pass never runs off the end of it. Everything
+        // that's measured from the same origin moves with it.
+        // A pass through borrowed frames can leave the read head several times round the ring, so move back by whole rings.
+        size_t ringFrames = mSourceRing.getNumFrames();
+        size_t rebaseFrames = getReadHeadFrame() & ~(ringFrames - 1);
+        if (rebaseFrames == 0) {
+          return;
+        }
+        mSourceBufferReadHead -= rebaseFrames;
+        mFixedSourceBufferReadHead -= (int64_t)rebaseFrames << FIXED_POINT_FRACTION_BITS;
+        mSourceFramesFilled -= rebaseFrames;
+        mBorrowedStart -= (int64_t)rebaseFrames;
+        if (mSourceEnd != SOURCE_NOT_ENDED) {
+          mSourceEnd -= rebaseFrames;
+        }
+      }
   
+      // Renderer's instantiation lives in RealtimeResampler.cpp
+      extern template class BasicRenderer<DynamicInterpolator, 0, DynamicFilterChain>;
   
 }
 
@@ -0,0 +1,194 @@
+//
+//  RealtimeResamplerAdaptive.cpp
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "RealtimeResamplerAdaptive.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace RealtimeResampler {
+
+  const double AdaptiveResampler::MAX_CORRECTION = 0.05;
+
+  // The fill level is smoothed by a one pole low-pass this many times the controller's bandwidth
+  static const double FILL_SMOOTHING = 4;
+
+  static double steadyClock(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  AdaptiveResampler::AdaptiveResampler(float inputSampleRate, float outputSampleRate, int numChannels, size_t fifoFrames, size_t maxFramesToRender) :
+    mRenderer(outputSampleRate, numChannels, 64, maxFramesToRender),
+    mFifo(fifoFrames, numChannels),
+    mNumChannels(numChannels),
+    mInputSampleRate(inputSampleRate),
+    mOutputSampleRate(outputSampleRate),
+    mNominalRatio((double)inputSampleRate / outputSampleRate),
+    mTargetFill(0),
+    mBandwidth(0),
+    mMaxCorrection(0.005),
+    mSmoothedError(0),
+    mIntegral(0),
+    mCorrection(0),
+    mStarted(false),
+    mClock(steadyClock),
+    mFramesRead(0),
+    mFramesWritten(0),
+    mStampSequence(0),
+    mStampFrames(0),
+    mStampSize(0),
+    mStampTime(0),
+    mUnderruns(0),
+    mOverruns(0)
+  {
+    // pull exactly what each block needs, so the only buffering that counts is the fifo's
+    mRenderer.setExactSourcePull(true, (float)(mNominalRatio * (1 + MAX_CORRECTION)));
+    mRenderer.setAudioSource(this);
+    mRenderer.setPitch(mNominalRatio, mNominalRatio, 0);
+    setTargetLatency(0.01);
+    setBandwidth(0.1);
+  }
+
+  size_t AdaptiveResampler::write(const SampleType* frames, size_t numFrames){
+    size_t framesWritten = mFifo.write(frames, numFrames);
+    if (framesWritten < numFrames) {
+      mOverruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    double now = mClock();
+    mFramesWritten += framesWritten;
+    unsigned int sequence = mStampSequence.load(std::memory_order_relaxed);
+    mStampSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mStampFrames.store(mFramesWritten, std::memory_order_relaxed);
+    mStampSize.store(framesWritten, std::memory_order_relaxed);
+    mStampTime.store(now, std::memory_order_relaxed);
+    mStampSequence.store(sequence + 2, std::memory_order_release);
+    return framesWritten;
+  }
+
+  size_t AdaptiveResampler::render(SampleType* outputBuffer, size_t numFrames){
+    if (!mStarted) {
+      if (mFifo.getNumFramesAvailable() < mTargetFill) {
+        memset(outputBuffer, 0, numFrames * mNumChannels * sizeof(SampleType));
+        return numFrames;
+      }
+      mStarted = true;
+    }
+
+    // PI control of the fill level, critically damped at mBandwidth. The fill level falls at the rate the pitch is above
+    // the actual ratio of the clocks, so correcting the pitch by the fill error times 2 * bandwidth, plus the integral of
+    // the error times bandwidth^2, gives it a double pole at -bandwidth.
+    double blockTime = numFrames / mOutputSampleRate;
+    double error = (estimateFillLevel(mClock()) - (double)mTargetFill) / mInputSampleRate;
+    mSmoothedError += (error - mSmoothedError) * (1 - exp(-FILL_SMOOTHING * mBandwidth * blockTime));
+    double integral = mIntegral + mSmoothedError * blockTime;
+    double correction = 2 * mBandwidth * mSmoothedError + mBandwidth * mBandwidth * integral;
+    if (fabs(correction) <= mMaxCorrection) {
+      mIntegral = integral;
+    }else{
+      // hold the integral while the correction is limited, so it doesn't wind up
+      correction = correction > 0 ? mMaxCorrection : -mMaxCorrection;
+    }
+    mCorrection = correction;
+
+    mRenderer.setPitch(mRenderer.getCurrentPitch(), (float)(mNominalRatio * (1 + mCorrection)), (float)blockTime);
+    mRenderer.render(outputBuffer, numFrames);
+    return numFrames;
+  }
+
+  size_t AdaptiveResampler::getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels){
+    size_t framesRead = mFifo.read(outputBuffer, numFramesRequested);
+    mFramesRead += framesRead;
+    if (framesRead < numFramesRequested) {
+      // Ran dry. Carry on with silence, rather than ending the renderer's source, and wait for the fifo to fill again.
+      memset(outputBuffer + framesRead * numChannels, 0, (numFramesRequested - framesRead) * numChannels * sizeof(SampleType));
+      if (mStarted) {
+        mUnderruns.fetch_add(1, std::memory_order_relaxed);
+        mStarted = false;
+      }
+    }
+    return numFramesRequested;
+  }
+
+  double AdaptiveResampler::estimateFillLevel(double now){
+    // Read the last write's timestamp, trying again if the input thread was part way through changing it. Only the input
+    // thread's writes can interrupt it, so it can't go on for long.
+    size_t stampFrames, stampSize;
+    double stampTime;
+    unsigned int sequence;
+    do {
+      sequence = mStampSequence.load(std::memory_order_acquire);
+      stampFrames = mStampFrames.load(std::memory_order_relaxed);
+      stampSize = mStampSize.load(std::memory_order_relaxed);
+      stampTime = mStampTime.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || sequence != mStampSequence.load(std::memory_order_relaxed));
+    
+    // The input carries on arriving after the last write, until the next one. If that's late, don't count on more than a
+    // block's worth.
+    double arrived = std::min((now - stampTime) * mInputSampleRate, (double)stampSize);
+    return (double)stampFrames - (double)mFramesRead + std::max(arrived, 0.0);
+  }
+
+  void AdaptiveResampler::setTargetLatency(double seconds){
+    mTargetFill = (size_t)(seconds * mInputSampleRate + 0.5);
+    assert(mTargetFill <= mFifo.getCapacity());
+  }
+
+  void AdaptiveResampler::setBandwidth(double hz){
+    mBandwidth = 2 * M_PI * hz;
+  }
+
+  void AdaptiveResampler::setMaxCorrection(double maxCorrection){
+    mMaxCorrection = std::min(maxCorrection, MAX_CORRECTION);
+  }
+
+  double AdaptiveResampler::getRatio(){
+    return mNominalRatio * (1 + mCorrection);
+  }
+
+  size_t AdaptiveResampler::getFillLevel(){
+    return mFifo.getNumFramesAvailable();
+  }
+
+  void AdaptiveResampler::setClock(double (*clock)()){
+    mClock = clock;
+  }
+
+  size_t AdaptiveResampler::getUnderrunCount(){
+    return mUnderruns.load(std::memory_order_relaxed);
+  }
+
+  size_t AdaptiveResampler::getOverrunCount(){
+    return mOverruns.load(std::memory_order_relaxed);
+  }
+
+  void AdaptiveResampler::reset(){
+    mFifo.reset();
+    mRenderer.reset();
+    mRenderer.setPitch(mNominalRatio, mNominalRatio, 0);
+    mSmoothedError = 0;
+    mIntegral = 0;
+    mCorrection = 0;
+    mStarted = false;
+    mFramesRead = 0;
+    mFramesWritten = 0;
+    mStampSequence.store(0);
+    mStampFrames.store(0);
+    mStampSize.store(0);
+    mStampTime.store(0);
+    mUnderruns.store(0);
+    mOverruns.store(0);
+  }
+
+}
@@ -0,0 +1,134 @@
+//
+//  RealtimeResamplerAdaptive.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerAdaptive__
+#define __EliasResamplerDemo__RealtimeResamplerAdaptive__
+
+#include <stdio.h>
+#include <atomic>
+#include "RealtimeResampler.h"
+
+namespace RealtimeResampler {
+
+  //////////////////////////////////////////
+  /// Adaptive resampler
+  //////////////////////////////////////////
+
+  /*!
+    Bridges two audio devices whose clocks drift apart, for example passing a capture device's input to a playback device.
+    The input thread writes frames as they arrive, into a lock-free fifo. The output thread renders them at the output rate
+    through a Renderer, whose pitch follows the ratio of the two rates, corrected by how far the fifo's fill level is from
+    the target latency.
+
+    The correction comes from a PI controller on the fill level, tuned to be critically damped at the bandwidth given to
+    setBandwidth. Each write is timestamped, and the fill level at each render is worked out from the frames written and
+    read so far plus the input that's arrived since the last write, so it doesn't jump as blocks arrive. That leaves a
+    smooth measurement however the input and output block sizes line up. It's smoothed further to keep timing jitter out
+    of the pitch, and the pitch glides from each correction to the next across the rendered block. Once settled, the fifo
+    holds the target latency on average, and the pitch has found the actual ratio of the two clocks.
+
+    Rendering outputs silence until the fifo first holds the target latency, and again after the fifo runs dry, which
+    counts as an underrun. A write that doesn't fit in the fifo drops the frames that don't, which counts as an overrun.
+
+    Nothing here allocates or locks once constructed. write must only be called from one thread, and render and the
+    settings from one other thread. Configure the renderer (the interpolator and filters) before the first render.
+  */
+
+  class AdaptiveResampler : protected AudioSource{
+  public:
+
+    /*!
+      The fifo holds at least fifoFrames input frames. maxFramesToRender is passed on to the Renderer.
+    */
+
+    AdaptiveResampler(float inputSampleRate, float outputSampleRate, int numChannels, size_t fifoFrames, size_t maxFramesToRender = 64);
+
+    // Input thread. Returns the number of frames that fit in the fifo.
+    size_t                      write(const SampleType* frames, size_t numFrames);
+
+    // Output thread. Always renders numFrames frames, silent until there's enough input.
+    size_t                      render(SampleType* outputBuffer, size_t numFrames);
+
+    /*!
+      The fill level to aim for, in seconds of input. This is the added latency. Just before a block arrives the fifo holds
+      about this less a block written, and that needs to cover a block rendered, so it should be more than the largest
+      block written plus the largest block rendered, with some to spare for timing jitter. It must also leave room in the
+      fifo for a block written on top. The default is 10ms. Output thread.
+    */
+
+    void                        setTargetLatency(double seconds);
+
+    /*!
+      How fast the controller follows changes, in Hz. Higher settles faster, lower lets less of the input and output
+      timing jitter into the pitch. The default is 0.1Hz. Output thread.
+    */
+
+    void                        setBandwidth(double hz);
+
+    // The largest correction to the ratio, as a fraction of it, up to MAX_CORRECTION. The default is 0.005. Output thread.
+    void                        setMaxCorrection(double maxCorrection);
+
+    // Output thread. The number of source frames played for each output frame.
+    double                      getRatio();
+
+    // Either thread. The frames waiting in the fifo.
+    size_t                      getFillLevel();
+    
+    /*!
+      The clock that timestamps writes and renders, in seconds. A monotonic system clock by default. Tests can simulate
+      the two devices' clocks by setting this to a function returning the simulated time. Set it before the first write.
+    */
+    
+    void                        setClock(double (*clock)());
+
+    size_t                      getUnderrunCount();
+    size_t                      getOverrunCount();
+
+    // Empty the fifo and start again, waiting for the target latency. Neither thread may be using it.
+    void                        reset();
+
+    Renderer&                   getRenderer(){ return mRenderer; }
+
+    const static double         MAX_CORRECTION; // the ratio never strays further than this fraction from the nominal ratio
+
+  protected:
+
+    size_t                      getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels);
+    double                      estimateFillLevel(double now);
+
+    Renderer                    mRenderer;
+    FrameFifo                   mFifo;
+    int                         mNumChannels;
+    double                      mInputSampleRate;
+    double                      mOutputSampleRate;
+    double                      mNominalRatio; // inputSampleRate / outputSampleRate
+    size_t                      mTargetFill; // frames
+    double                      mBandwidth; // radians per second
+    double                      mMaxCorrection;
+    double                      mSmoothedError; // the fill level's distance from the target, smoothed, in seconds
+    double                      mIntegral; // the integral of mSmoothedError over time
+    double                      mCorrection; // the fraction the pitch is above the nominal ratio
+    bool                        mStarted; // whether the fifo has reached the target since the start or the last underrun
+    double                      (*mClock)();
+    size_t                      mFramesRead; // since the start. Output thread only
+    size_t                      mFramesWritten; // since the start. Input thread only
+    std::atomic<unsigned int>   mStampSequence; // The last write's timestamp, published with a sequence lock: odd while it's changing
+    std::atomic<size_t>         mStampFrames; // mFramesWritten after the write,
+    std::atomic<size_t>         mStampSize; // the number of frames written,
+    std::atomic<double>         mStampTime; // and when
+    std::atomic<size_t>         mUnderruns;
+    std::atomic<size_t>         mOverruns;
+
+  };
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerAdaptive__) */
@@ -11,6 +11,8 @@
 
 #include "RealtimeResamplerBuffer.h"
 #include "RealtimeResampler.h"
+#include <algorithm>
+#include <cassert>
 
 namespace RealtimeResampler{
 
@@ -26,7 +28,8 @@ namespace RealtimeResampler{
         Buffer::Buffer(const Buffer &other):
           mNumSamples(other.mNumSamples),
           mFrontPadding(other.mFrontPadding),
-          length(other.length)
+          length(other.length),
+          mData(0)
         {
           init();
         }
@@ -44,7 +47,7 @@ namespace RealtimeResampler{
         void Buffer::init(){
           size_t bytes = (mNumSamples + mFrontPadding) * sizeof(SampleType);
           if (mData) {
-            free(mData);
+            freeFn(mData);
           }
           mData = (SampleType*)(*mallocFn)(bytes);
           start = mData + mFrontPadding;
@@ -63,4 +66,168 @@ namespace RealtimeResampler{
           return start;
         }
 
+        IndexBuffer::IndexBuffer(size_t numIndices):
+          mNumIndices(numIndices),
+          mData(0)
+        {
+          init();
+        }
+  
+        IndexBuffer::IndexBuffer(const IndexBuffer &other):
+          mNumIndices(other.mNumIndices),
+          mData(0)
+        {
+          init();
+        }
+  
+        IndexBuffer& IndexBuffer::operator= (const IndexBuffer& other){
+          mNumIndices = other.mNumIndices;
+          init();
+          return *this;
+        }
+  
+        IndexBuffer::~IndexBuffer(){  freeFn(mData); }
+  
+        void IndexBuffer::init(){
+          size_t bytes = mNumIndices * sizeof(int);
+          if (mData) {
+            freeFn(mData);
+          }
+          mData = (int*)(*mallocFn)(bytes);
+          memset(mData, 0, bytes);
+        }
+  
+        int* IndexBuffer::getStartPtr(){
+          return mData;
+        }
+
+        RingBuffer::RingBuffer(size_t minNumFrames, size_t numChannels, size_t frontGuard, size_t backGuard):
+          mNumFrames(1),
+          mNumChannels(numChannels),
+          mFrontGuard(frontGuard),
+          mBackGuard(backGuard),
+          mData(0)
+        {
+          while (mNumFrames < minNumFrames) {
+            mNumFrames <<= 1;
+          }
+          mMask = mNumFrames - 1;
+          // the guards are copied from inside the ring
+          assert(frontGuard <= mNumFrames && backGuard <= mNumFrames);
+          init();
+        }
+  
+        RingBuffer::RingBuffer(const RingBuffer &other):
+          mNumFrames(other.mNumFrames),
+          mMask(other.mMask),
+          mNumChannels(other.mNumChannels),
+          mFrontGuard(other.mFrontGuard),
+          mBackGuard(other.mBackGuard),
+          mData(0)
+        {
+          init();
+        }
+  
+        RingBuffer& RingBuffer::operator= (const RingBuffer& other){
+          mNumFrames = other.mNumFrames;
+          mMask = other.mMask;
+          mNumChannels = other.mNumChannels;
+          mFrontGuard = other.mFrontGuard;
+          mBackGuard = other.mBackGuard;
+          init();
+          return *this;
+        }
+  
+        RingBuffer::~RingBuffer(){  freeFn(mData); }
+  
+        void RingBuffer::init(){
+          if (mData) {
+            freeFn(mData);
+          }
+          mData = (SampleType*)(*mallocFn)((mFrontGuard + mNumFrames + mBackGuard) * mNumChannels * sizeof(SampleType));
+          mStart = mData + mFrontGuard * mNumChannels;
+          clear();
+        }
+  
+        size_t RingBuffer::getNumFrames() const{
+          return mNumFrames;
+        }
+  
+        SampleType* RingBuffer::getFramePtr(size_t position){
+          return mStart + (position & mMask) * mNumChannels;
+        }
+  
+        void RingBuffer::mirror(size_t position, size_t numFrames){
+          size_t first = position & mMask;
+          size_t end = first + numFrames;
+          assert(end <= mNumFrames + mBackGuard);
+          // frames written past the end of the ring belong at the start of it. They're already in the guard.
+          if (end > mNumFrames) {
+            memcpy(mStart, mStart + mNumFrames * mNumChannels, (end - mNumFrames) * mNumChannels * sizeof(SampleType));
+          }
+          // the start of the ring is copied after the end
+          if (first < mBackGuard) {
+            size_t last = std::min(end, mBackGuard);
+            memcpy(mStart + (mNumFrames + first) * mNumChannels, mStart + first * mNumChannels, (last - first) * mNumChannels * sizeof(SampleType));
+          }
+          // the end of the ring is copied before the start
+          if (end > mNumFrames - mFrontGuard && first < mNumFrames) {
+            size_t from = std::max(first, mNumFrames - mFrontGuard);
+            size_t to = std::min(end, mNumFrames);
+            memcpy(mStart - (mNumFrames - from) * mNumChannels, mStart + from * mNumChannels, (to - from) * mNumChannels * sizeof(SampleType));
+          }
+        }
+  
+        void RingBuffer::clear(){
+          memset(mData, 0, (mFrontGuard + mNumFrames + mBackGuard) * mNumChannels * sizeof(SampleType));
+        }
+
+  
+        FrameFifo::FrameFifo(size_t minNumFrames, size_t numChannels):
+          mRing(minNumFrames, numChannels),
+          mNumChannels(numChannels),
+          mWritePosition(0),
+          mReadPosition(0)
+        {
+        }
+  
+        size_t FrameFifo::getCapacity() const{
+          return mRing.getNumFrames();
+        }
+  
+        size_t FrameFifo::write(const SampleType* frames, size_t numFrames){
+          // The reader's position is acquired so the frames it has finished reading aren't overwritten under it, and the new
+          // position released so the reader sees the frames before it sees the position move past them.
+          size_t writePosition = mWritePosition.load(std::memory_order_relaxed);
+          size_t readPosition = mReadPosition.load(std::memory_order_acquire);
+          numFrames = std::min(numFrames, mRing.getNumFrames() - (writePosition - readPosition));
+          // the frames wrap around the end of the ring in two parts
+          size_t firstPart = std::min(numFrames, mRing.getNumFrames() - (writePosition & (mRing.getNumFrames() - 1)));
+          memcpy(mRing.getFramePtr(writePosition), frames, firstPart * mNumChannels * sizeof(SampleType));
+          memcpy(mRing.getFramePtr(0), frames + firstPart * mNumChannels, (numFrames - firstPart) * mNumChannels * sizeof(SampleType));
+          mWritePosition.store(writePosition + numFrames, std::memory_order_release);
+          return numFrames;
+        }
+  
+        size_t FrameFifo::read(SampleType* frames, size_t numFrames){
+          size_t readPosition = mReadPosition.load(std::memory_order_relaxed);
+          size_t writePosition = mWritePosition.load(std::memory_order_acquire);
+          numFrames = std::min(numFrames, writePosition - readPosition);
+          size_t firstPart = std::min(numFrames, mRing.getNumFrames() - (readPosition & (mRing.getNumFrames() - 1)));
+          memcpy(frames, mRing.getFramePtr(readPosition), firstPart * mNumChannels * sizeof(SampleType));
+          memcpy(frames + firstPart * mNumChannels, mRing.getFramePtr(0), (numFrames - firstPart) * mNumChannels * sizeof(SampleType));
+          mReadPosition.store(readPosition + numFrames, std::memory_order_release);
+          return numFrames;
+        }
+  
+        size_t FrameFifo::getNumFramesAvailable() const{
+          size_t readPosition = mReadPosition.load(std::memory_order_acquire);
+          return mWritePosition.load(std::memory_order_acquire) - readPosition;
+        }
+  
+        void FrameFifo::reset(){
+          mWritePosition.store(0);
+          mReadPosition.store(0);
+        }
+
 }
@@ -13,6 +13,7 @@
 #define __EliasResamplerDemo__RealtimeResamplerBuffer__
 
 #include <stdio.h>
+#include <atomic>
 #include "RealtimeResamplerCommon.h"
 
 namespace RealtimeResampler {
@@ -74,6 +75,132 @@ namespace RealtimeResampler {
         SampleType*             start;
         
       };
+  
+      /*!
+        Memory-managed array of integer frame indices. Used alongside a Buffer of fractions to describe interpolation
+        positions without any float to int conversion in the interpolators.
+       
+        Copy and assignment constructors do NOT copy the indices.
+      */
+  
+      class IndexBuffer{
+      public:
+        IndexBuffer(size_t numIndices);
+        
+        ~IndexBuffer();
+        
+        // copy constructor
+        IndexBuffer(const IndexBuffer &other);
+        
+        // assignment operator
+        IndexBuffer& operator= (const IndexBuffer& other);
+        
+        int*                    getStartPtr();
+        
+      protected:
+      
+        size_t                  mNumIndices;
+      
+        void                    init();
+        
+        int*                    mData;
+      
+      };
+
+  
+      /*!
+        Ring of interleaved audio frames. The capacity is rounded up to a power of two so frame positions wrap with a mask.
+       
+        The ring is surrounded by guard regions that mirror the frames at the other end of the ring: frontGuard frames before
+        frame zero hold copies of the last frames of the ring, and backGuard frames after the last frame hold copies of the first
+        frames. So reading up to frontGuard frames behind or backGuard frames ahead of any frame never needs to wrap. Call mirror
+        after writing to keep the guards up to date.
+       
+        Copy and assignment constructors do NOT copy audio data. Data must be explicitly copied.
+      */
+  
+      class RingBuffer{
+      public:
+        RingBuffer(size_t minNumFrames, size_t numChannels, size_t frontGuard=0, size_t backGuard=0);
+        
+        ~RingBuffer();
+        
+        // copy constructor
+        RingBuffer(const RingBuffer &other);
+        
+        // assignment operator
+        RingBuffer& operator= (const RingBuffer& other);
+        
+        // The number of frames in the ring. Always a power of two.
+        size_t                  getNumFrames() const;
+        
+        // Pointer to the frame at position, which wraps around the ring
+        SampleType*             getFramePtr(size_t position);
+        
+        // Update the guards after writing numFrames frames starting at position. The frames may be written straight on past
+        // the end of the ring into the back guard, as long as they fit. Those are then moved to the start of the ring.
+        void                    mirror(size_t position, size_t numFrames);
+        
+        //  set all the samples, including the guards, to zero
+        void                    clear();
+        
+      protected:
+      
+        void                    init();
+        
+        size_t                  mNumFrames;
+        size_t                  mMask;
+        size_t                  mNumChannels;
+        size_t                  mFrontGuard; // in frames
+        size_t                  mBackGuard;
+        
+        // All of the memory owned by this object
+        SampleType*             mData;
+        
+        // mData, offset by the front guard. Frame zero of the ring
+        SampleType*             mStart;
+      
+      };
+
+  
+      /*!
+        Lock-free queue of interleaved audio frames, for handing audio from one thread to another. One thread writes and one
+        thread reads. Neither ever blocks or allocates: a write that doesn't fit, or a read of more than is there, just moves
+        fewer frames. The capacity is rounded up to a power of two.
+       
+        Not copyable.
+      */
+  
+      class FrameFifo{
+      public:
+        FrameFifo(size_t minNumFrames, size_t numChannels);
+        
+        // The number of frames the fifo holds when full. Always a power of two.
+        size_t                  getCapacity() const;
+        
+        // Writer thread. Returns the number of frames written, which is less than numFrames if the fifo fills up.
+        size_t                  write(const SampleType* frames, size_t numFrames);
+        
+        // Reader thread. Returns the number of frames read, which is less than numFrames if the fifo runs out.
+        size_t                  read(SampleType* frames, size_t numFrames);
+        
+        // Either thread. The number of frames waiting to be read. The other thread may change it at any moment.
+        size_t                  getNumFramesAvailable() const;
+        
+        // Empty the fifo. Neither thread may be using it.
+        void                    reset();
+        
+      protected:
+      
+        // Copy numFrames frames between the ring at position and frames, in two parts if they wrap
+        void                    copy(size_t position, SampleType* frames, size_t numFrames, bool toRing);
+        
+        RingBuffer              mRing;
+        size_t                  mNumChannels;
+        std::atomic<size_t>     mWritePosition; // frames written since the start. Only the writer changes it
+        std::atomic<size_t>     mReadPosition; // frames read since the start. Only the reader changes it
+      
+      };
 
 }
 
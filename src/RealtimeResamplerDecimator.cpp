@@ -0,0 +1,178 @@
+//
+//  RealtimeResamplerDecimator.cpp
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "RealtimeResamplerDecimator.h"
+#include "RealtimeResamplerInterpolator.h"
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+namespace RealtimeResampler{
+
+  //////////////////////////////////////////
+  /// Half-band decimator
+  //////////////////////////////////////////
+  
+  static const double HALF_BAND_STOPBAND_ATTENUATION = 80; // dB, the Kaiser window design target
+  static const int HALF_BAND_SIDE_TAPS = (HalfBandDecimator::NUM_TAPS + 1) / 4;
+  
+  HalfBandDecimator::HalfBandDecimator():
+    mNumChannels(1),
+    mHistory(HISTORY_FRAMES, 1)
+  {
+    double params[] = {(double)NUM_TAPS};
+    mTaps = SharedTable("HalfBandDecimator", params, 1, HALF_BAND_SIDE_TAPS, buildTaps);
+  }
+  
+  void HalfBandDecimator::buildTaps(SampleType* values, size_t numValues, const double* params){
+    double beta = 0.1102 * (HALF_BAND_STOPBAND_ATTENUATION - 8.7);
+    double windowNormalization = 1.0 / besselI0(beta);
+    double sum = 0;
+    double taps[HALF_BAND_SIDE_TAPS];
+    for (int i = 0; i < HALF_BAND_SIDE_TAPS; i++) {
+      // the taps at odd distances from the centre. A half-band filter's taps at even distances are all zero.
+      double x = 2 * i + 1;
+      double r = x / DELAY;
+      double window = besselI0(beta * sqrt(std::max(0.0, 1 - r * r))) * windowNormalization;
+      taps[i] = sin(M_PI * x / 2) / (M_PI * x) * window;
+      sum += 2 * taps[i];
+    }
+    // unity gain at DC, with the centre tap at one half
+    for (int i = 0; i < HALF_BAND_SIDE_TAPS; i++) {
+      values[i] = taps[i] * 0.5 / sum;
+    }
+  }
+  
+  void HalfBandDecimator::init(int numChannels){
+    mNumChannels = numChannels;
+    mHistory = Buffer(HISTORY_FRAMES, numChannels);
+  }
+  
+  void HalfBandDecimator::process(SampleType* input, size_t numInputFrames, SampleType* output){
+  
+    assert(numInputFrames % 2 == 0);
+    
+    const int channels = mNumChannels;
+    const SampleType* taps = mTaps.getValues();
+    
+    // put the end of the last input right before this one
+    memcpy(input - HISTORY_FRAMES * channels, mHistory.getStartPtr(), HISTORY_FRAMES * channels * sizeof(SampleType));
+    
+    // each output is made when its second input frame arrives
+    for (size_t frame = 1; frame < numInputFrames; frame += 2) {
+      const SampleType* centre = input + ((int)frame - DELAY) * channels;
+      for (int chan = 0; chan < channels; chan++) {
+        SampleType sum = 0;
+        for (int i = 0; i < HALF_BAND_SIDE_TAPS; i++) {
+          int offset = (2 * i + 1) * channels;
+          sum += taps[i] * (centre[chan - offset] + centre[chan + offset]);
+        }
+        *output++ = sum + 0.5f * centre[chan];
+      }
+    }
+    
+    memcpy(mHistory.getStartPtr(), input + ((int)numInputFrames - HISTORY_FRAMES) * channels, HISTORY_FRAMES * channels * sizeof(SampleType));
+  }
+  
+  void HalfBandDecimator::reset(){
+    mHistory.clear();
+  }
+  
+  const SampleType* HalfBandDecimator::getHistory(){
+    return mHistory.getStartPtr();
+  }
+
+  //////////////////////////////////////////
+  /// Mipmap table
+  //////////////////////////////////////////
+  
+  MipmapTable::MipmapTable():
+    mSource(0),
+    mNumChannels(1),
+    mNumOctaves(0),
+    mOctaves(0, 1)
+  {
+    memset(mOctaveFrames, 0, sizeof(mOctaveFrames));
+    memset(mOctaveStart, 0, sizeof(mOctaveStart));
+  }
+  
+  void MipmapTable::build(const SampleType* frames, size_t numFrames, int numChannels, int numOctaves){
+  
+    mSource = frames;
+    mNumChannels = numChannels;
+    mNumOctaves = std::max(0, std::min(numOctaves, (int)MAX_OCTAVES));
+    
+    // Each octave holds enough frames to cover the buffer and then the delay through its decimators
+    mOctaveFrames[0] = numFrames;
+    size_t totalFrames = 0;
+    for (int octave = 1; octave <= mNumOctaves; octave++) {
+      size_t decimation = (size_t)1 << octave;
+      mOctaveFrames[octave] = (numFrames + HalfBandDecimator::DELAY * (decimation - 1) + decimation - 1) >> octave;
+      mOctaveStart[octave] = totalFrames;
+      totalFrames += mOctaveFrames[octave];
+    }
+    mOctaves = Buffer(totalFrames, numChannels);
+    mOctaves.length = totalFrames;
+    
+    // Each octave is the one above it run through a fresh decimator, followed by silence
+    HalfBandDecimator decimator;
+    decimator.init(numChannels);
+    for (int octave = 1; octave <= mNumOctaves; octave++) {
+      size_t inputFrames = 2 * mOctaveFrames[octave];
+      size_t framesAbove = std::min(mOctaveFrames[octave - 1], inputFrames);
+      Buffer input(inputFrames, numChannels, HalfBandDecimator::HISTORY_FRAMES);
+      memcpy(input.getStartPtr(), getFrames(octave - 1), framesAbove * numChannels * sizeof(SampleType));
+      decimator.reset();
+      decimator.process(input.getStartPtr(), inputFrames, mOctaves.getStartPtr() + mOctaveStart[octave] * numChannels);
+    }
+  }
+  
+  const SampleType* MipmapTable::getFrames(int octave){
+    assert(octave >= 0 && octave <= mNumOctaves);
+    if (octave == 0) {
+      return mSource;
+    }
+    return mOctaves.getStartPtr() + mOctaveStart[octave] * mNumChannels;
+  }
+  
+  int MipmapTable::getNumOctavesAt(size_t position) const{
+    int octaves = 0;
+    while (octaves < mNumOctaves && (position & (((size_t)2 << octaves) - 1)) == 0) {
+      octaves++;
+    }
+    return octaves;
+  }
+  
+  size_t MipmapTable::read(int octave, size_t position, SampleType* output, size_t numFrames){
+    size_t first = position >> octave;
+    size_t framesToCopy = first < mOctaveFrames[octave] ? std::min(numFrames, mOctaveFrames[octave] - first) : 0;
+    memcpy(output, getFrames(octave) + first * mNumChannels, framesToCopy * mNumChannels * sizeof(SampleType));
+    return framesToCopy;
+  }
+  
+  void MipmapTable::readHistory(int octave, size_t position, SampleType* output, size_t numFrames){
+    // frames past the end of the octave are silence, the same as frames before the start
+    size_t end = position >> octave;
+    size_t zeroFrames = numFrames > end ? numFrames - end : 0;
+    memset(output, 0, zeroFrames * mNumChannels * sizeof(SampleType));
+    size_t first = end - (numFrames - zeroFrames);
+    for (size_t frame = first; frame < end; frame++) {
+      SampleType* out = output + (frame - first + zeroFrames) * mNumChannels;
+      if (frame < mOctaveFrames[octave]) {
+        memcpy(out, getFrames(octave) + frame * mNumChannels, mNumChannels * sizeof(SampleType));
+      }else{
+        memset(out, 0, mNumChannels * sizeof(SampleType));
+      }
+    }
+  }
+
+}
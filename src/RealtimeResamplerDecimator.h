@@ -0,0 +1,123 @@
+//
+//  RealtimeResamplerDecimator.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerDecimator__
+#define __EliasResamplerDemo__RealtimeResamplerDecimator__
+
+#include <stdio.h>
+#include "RealtimeResamplerBuffer.h"
+#include "RealtimeResamplerSharedTable.h"
+
+namespace RealtimeResampler {
+
+  //////////////////////////////////////////
+  /// Half-band decimator
+  //////////////////////////////////////////
+
+  /*!
+    Halves the sample rate of interleaved frames. A Kaiser windowed half-band FIR low-pass runs ahead of dropping every other
+    frame. It passes up to 0.16 of the input rate within 0.002 dB, and attenuates everything from 0.34 of the input rate on by
+    77 dB or more, so with a little headroom below the output Nyquist frequency, cascading stages gives a clean decimation by
+    any power of two. Every other tap of a half-band filter is zero and the rest are symmetric, so each output frame costs
+    (NUM_TAPS + 1) / 4 multiplies per channel.
+   
+    The filter is linear phase. An output frame is centred DELAY input frames before the last input frame it was made from.
+  */
+
+  class HalfBandDecimator{
+  public:
+  
+    enum {                      NUM_TAPS = 31, HISTORY_FRAMES = NUM_TAPS - 1, DELAY = (NUM_TAPS - 1) / 2 };
+  
+    HalfBandDecimator();
+  
+    void                        init(int numChannels);
+  
+    /*!
+      Decimate an even number of input frames into numInputFrames / 2 output frames. The HISTORY_FRAMES frames before input
+      are used as scratch space, and output must not overlap input.
+    */
+  
+    void                        process(SampleType* input, size_t numInputFrames, SampleType* output);
+  
+    // Forget the previous input
+    void                        reset();
+  
+    // The last HISTORY_FRAMES input frames, oldest first
+    const SampleType*           getHistory();
+  
+  protected:
+  
+    static void                 buildTaps(SampleType* values, size_t numValues, const double* params);
+  
+    int                         mNumChannels;
+    Buffer                      mHistory;
+    SharedTable                 mTaps; // the nonzero taps either side of the centre, from the centre out
+  
+  };
+
+  //////////////////////////////////////////
+  /// Mipmap table
+  //////////////////////////////////////////
+
+  /*!
+    A precomputed pyramid of decimated copies of an in-memory buffer, one per octave down. Octave k is what k cascaded
+    HalfBandDecimators would make from the buffer played from its start, followed by silence, so a renderer can read it in
+    place of decimating in real time (see MipmapSource). Frame j of octave k is made once the source has played up to the
+    end of frame (j + 1) * 2^k, and each octave runs on past the end of the buffer until the decimators' delay has flushed.
+   
+    Octave 0 is the buffer itself. It isn't copied, and must outlive the table. The decimated octaves take up about as much
+    memory again as the buffer.
+  */
+
+  class MipmapTable{
+  public:
+  
+    enum {                      MAX_OCTAVES = 8 };
+  
+    MipmapTable();
+  
+    // Build numOctaves decimated copies of numFrames interleaved frames. This allocates.
+    void                        build(const SampleType* frames, size_t numFrames, int numChannels, int numOctaves);
+  
+    int                         getNumOctaves() const { return mNumOctaves; }
+    int                         getNumChannels() const { return mNumChannels; }
+    size_t                      getNumFrames(int octave) const { return mOctaveFrames[octave]; }
+    const SampleType*           getFrames(int octave);
+  
+    // How many octaves down can be read starting at position, in frames of the original. Octave k can only be read from
+    // a multiple of 2^k.
+    int                         getNumOctavesAt(size_t position) const;
+  
+    /*!
+      Copy up to numFrames frames of octave, starting from the one made once the source has played up to position. position
+      is rounded down to a multiple of 2^octave. Returns the number of frames copied, which is short at the end of the octave.
+    */
+  
+    size_t                      read(int octave, size_t position, SampleType* output, size_t numFrames);
+  
+    // The numFrames frames of octave before the one read would start from, oldest first. Zero before the start.
+    void                        readHistory(int octave, size_t position, SampleType* output, size_t numFrames);
+  
+  protected:
+  
+    const SampleType*           mSource;
+    int                         mNumChannels;
+    int                         mNumOctaves;
+    size_t                      mOctaveFrames[MAX_OCTAVES + 1];
+    size_t                      mOctaveStart[MAX_OCTAVES + 1]; // where each decimated octave starts in mOctaves, in frames
+    Buffer                      mOctaves;
+  
+  };
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerDecimator__) */
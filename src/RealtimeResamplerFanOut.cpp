@@ -0,0 +1,171 @@
+//
+//  RealtimeResamplerFanOut.cpp
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "RealtimeResamplerFanOut.h"
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+namespace RealtimeResampler {
+
+  //////////////////////////////////////////
+  /// FanOutTap
+  //////////////////////////////////////////
+
+  FanOutTap::FanOutTap() :
+    mFanOut(NULL),
+    mStream(0),
+    mPosition(0)
+  {}
+
+  size_t FanOutTap::getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels){
+    assert(numChannels == mFanOut->mNumChannels);
+    return mFanOut->read(this, outputBuffer, numFramesRequested);
+  }
+
+  //////////////////////////////////////////
+  /// SourceFanOut
+  //////////////////////////////////////////
+
+  SourceFanOut::SourceFanOut(float sampleRate, int numChannels, size_t cacheFrames, size_t blockFrames, int maxTaps) :
+    mSampleRate(sampleRate),
+    mNumChannels(numChannels),
+    mBlockFrames(blockFrames),
+    mMaxTaps(maxTaps),
+    mAudioSource(NULL),
+    mStreams(new Stream*[maxTaps + 1]),
+    mNumStreams(1),
+    mTaps(new FanOutTap[maxTaps]),
+    mNumTaps(0),
+    mFramesPulled(0),
+    mSourceEnded(false),
+    mDroppedFrames(0)
+  {
+    mStreams[0] = new Stream(numChannels, cacheFrames);
+    mCacheFrames = mStreams[0]->ring.getNumFrames();
+  }
+
+  SourceFanOut::~SourceFanOut(){
+    for (int stream = 0; stream < mNumStreams; stream++) {
+      delete mStreams[stream];
+    }
+    delete[] mStreams;
+    delete[] mTaps;
+  }
+
+  void SourceFanOut::setAudioSource(AudioSource* audioSource){
+    mAudioSource = audioSource;
+  }
+
+  FanOutTap* SourceFanOut::addTap(float pitch){
+    if (mNumTaps == mMaxTaps) {
+      return NULL;
+    }
+    // Share a stream filtered for the same pitch, or the unfiltered one if the pitch doesn't need filtering
+    int stream = 0;
+    if (pitch > 1) {
+      stream = 1;
+      while (stream < mNumStreams && mStreams[stream]->pitch != pitch) {
+        stream++;
+      }
+      if (stream == mNumStreams) {
+        Stream* newStream = new Stream(mNumChannels, mCacheFrames);
+        newStream->pitch = pitch;
+        newStream->filter.init(mSampleRate, mBlockFrames, mNumChannels);
+        // Catch up on what's cached already
+        filterStream(newStream, getOldestFrame(), mFramesPulled);
+        mStreams[mNumStreams++] = newStream;
+      }
+    }
+    FanOutTap* tap = &mTaps[mNumTaps++];
+    tap->mFanOut = this;
+    tap->mStream = stream;
+    tap->mPosition = getOldestFrame();
+    return tap;
+  }
+
+  void SourceFanOut::reset(){
+    mFramesPulled = 0;
+    mSourceEnded = false;
+    for (int stream = 0; stream < mNumStreams; stream++) {
+      mStreams[stream]->filter.reset();
+    }
+    for (int tap = 0; tap < mNumTaps; tap++) {
+      mTaps[tap].mPosition = 0;
+    }
+  }
+
+  uint64_t SourceFanOut::getOldestFrame(){
+    return mFramesPulled > mCacheFrames ? mFramesPulled - mCacheFrames : 0;
+  }
+
+  size_t SourceFanOut::read(FanOutTap* tap, SampleType* outputBuffer, size_t numFrames){
+    if (tap->mPosition + numFrames > mFramesPulled && !mSourceEnded) {
+      pull(tap->mPosition + numFrames);
+    }
+    // A tap that's fallen too far behind has lost what it didn't read
+    uint64_t oldestFrame = getOldestFrame();
+    if (tap->mPosition < oldestFrame) {
+      mDroppedFrames += (size_t)(oldestFrame - tap->mPosition);
+      tap->mPosition = oldestFrame;
+    }
+    size_t framesRead = (size_t)std::min((uint64_t)numFrames, mFramesPulled - tap->mPosition);
+
+    // Copy out of the ring, in two parts if the frames wrap
+    RingBuffer& ring = mStreams[tap->mStream]->ring;
+    size_t ringFrame = tap->mPosition & (mCacheFrames - 1);
+    size_t firstPiece = std::min(framesRead, mCacheFrames - ringFrame);
+    memcpy(outputBuffer, ring.getFramePtr(ringFrame), firstPiece * mNumChannels * sizeof(SampleType));
+    memcpy(outputBuffer + firstPiece * mNumChannels, ring.getFramePtr(0), (framesRead - firstPiece) * mNumChannels * sizeof(SampleType));
+    tap->mPosition += framesRead;
+    return framesRead;
+  }
+
+  void SourceFanOut::pull(uint64_t end){
+    // Whole blocks, as many as needed to reach end, as long as they fit in the cache
+    size_t blocks = (size_t)((end - mFramesPulled + mBlockFrames - 1) / mBlockFrames);
+    size_t framesToPull = std::min(blocks * mBlockFrames, mCacheFrames);
+
+    // Straight into the unfiltered ring
+    RingBuffer& ring = mStreams[0]->ring;
+    uint64_t start = mFramesPulled;
+    size_t framesPulled = 0;
+    while (framesPulled < framesToPull && mAudioSource) {
+      size_t ringFrame = (start + framesPulled) & (mCacheFrames - 1);
+      size_t framesRequested = std::min(framesToPull - framesPulled, mCacheFrames - ringFrame);
+      size_t framesReceived = mAudioSource->getSamples(ring.getFramePtr(ringFrame), framesRequested, mNumChannels);
+      framesPulled += framesReceived;
+      if (framesReceived < framesRequested) {
+        break;
+      }
+    }
+    mSourceEnded = framesPulled < framesToPull;
+    mFramesPulled += framesPulled;
+
+    // Then once for each pitch
+    for (int stream = 1; stream < mNumStreams; stream++) {
+      filterStream(mStreams[stream], start, mFramesPulled);
+    }
+  }
+
+  void SourceFanOut::filterStream(Stream* stream, uint64_t start, uint64_t end){
+    // Copy the unfiltered frames across and filter them in place, in two parts if they wrap
+    while (start < end) {
+      size_t ringFrame = start & (mCacheFrames - 1);
+      size_t numFrames = (size_t)std::min(end - start, (uint64_t)(mCacheFrames - ringFrame));
+      SampleType* frames = stream->ring.getFramePtr(ringFrame);
+      memcpy(frames, mStreams[0]->ring.getFramePtr(ringFrame), numFrames * mNumChannels * sizeof(SampleType));
+      stream->filter.process(frames, numFrames, stream->pitch, stream->pitch);
+      start += numFrames;
+    }
+  }
+
+}
@@ -0,0 +1,139 @@
+//
+//  RealtimeResamplerFanOut.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerFanOut__
+#define __EliasResamplerDemo__RealtimeResamplerFanOut__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "RealtimeResampler.h"
+#include "RealtimeResamplerFilter.h"
+
+namespace RealtimeResampler {
+
+  class SourceFanOut;
+
+  //////////////////////////////////////////
+  /// FanOutTap class.
+  //////////////////////////////////////////
+
+  /*!
+    One reader of a SourceFanOut, to give to a renderer as its audio source. Made by SourceFanOut::addTap, and owned by the
+    fan-out.
+  */
+
+  class FanOutTap : public AudioSource{
+
+    friend class SourceFanOut;
+
+    public:
+
+    size_t                        getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels);
+
+    // The position of the next frame, in frames of the source since the start
+    uint64_t                      getPosition(){ return mPosition; }
+
+    protected:
+
+    FanOutTap();
+
+    SourceFanOut*                 mFanOut;
+    int                           mStream;
+    uint64_t                      mPosition;
+
+  };
+
+  //////////////////////////////////////////
+  /// SourceFanOut class.
+  //////////////////////////////////////////
+
+  /*!
+    Shares one audio source between several renderers, for unison, chorus and harmonizer voices playing the same input at
+    different pitches. Each renderer reads the source through its own tap. The source is pulled once, into a cache the taps
+    all read from, and each frame stays cached until the cache wraps around.
+
+    A renderer playing faster than 1 would normally low-pass filter what it pulls. Instead, the fan-out filters the cache
+    once for each different pitch the taps are made for, with an LPF12 just like the one the renderer would have used, and
+    renderers reading those taps need no filters of their own. Taps for pitches of 1 or less read the source as it is, as
+    the renderer doesn't filter those. So the filtering, and the copies of the cache, grow with the number of different
+    pitches rather than the number of renderers. A renderer that glides should use an unfiltered tap, and its own filter.
+
+    The taps move through the source at their own renderers' pace, so they drift apart as it plays. A tap that falls more
+    than the cache's length behind the one furthest ahead skips the frames it's missed, which are counted as dropped.
+
+    All the taps must be read from one thread. Adding taps allocates; reading them doesn't.
+  */
+
+  class SourceFanOut{
+
+    friend class FanOutTap;
+
+    public:
+
+    // The cache holds at least cacheFrames frames. The source is pulled blockFrames at a time.
+    SourceFanOut(float sampleRate, int numChannels, size_t cacheFrames, size_t blockFrames = 64, int maxTaps = 16);
+    ~SourceFanOut();
+
+    // The source isn't owned, and must outlive the fan-out
+    void                          setAudioSource(AudioSource* audioSource);
+
+    /*!
+      A new tap, for a renderer with no filters playing at a steady pitch, or for any renderer with a pitch of 1. It starts
+      at the oldest frame still cached, which is the start of the source until the cache wraps. Returns 0 once there are
+      maxTaps taps.
+    */
+
+    FanOutTap*                    addTap(float pitch = 1);
+
+    // The distinct caches the taps read from, the unfiltered source included
+    int                           getNumStreams(){ return mNumStreams; }
+    size_t                        getDroppedFrameCount(){ return mDroppedFrames; }
+
+    // Empty the cache, reset the filters and move every tap back to the start, to play the source again from its start.
+    void                          reset();
+
+    protected:
+
+    SourceFanOut(const SourceFanOut&);
+    SourceFanOut& operator= (const SourceFanOut&);
+
+    // A copy of the cache, filtered for one pitch
+    struct Stream{
+      Stream(int numChannels, size_t cacheFrames) : ring(cacheFrames, numChannels), pitch(1) {}
+      RingBuffer                  ring;
+      float                       pitch;
+      StaticFilterChain<LPF12>    filter;
+    };
+
+    size_t                        read(FanOutTap* tap, SampleType* outputBuffer, size_t numFrames);
+    void                          pull(uint64_t end);
+    void                          filterStream(Stream* stream, uint64_t start, uint64_t end);
+    uint64_t                      getOldestFrame();
+
+    float                         mSampleRate;
+    int                           mNumChannels;
+    size_t                        mBlockFrames;
+    int                           mMaxTaps;
+    AudioSource*                  mAudioSource;
+    Stream**                      mStreams; // Up to mMaxTaps + 1. The first is the source as it is.
+    int                           mNumStreams;
+    FanOutTap*                    mTaps;
+    int                           mNumTaps;
+    size_t                        mCacheFrames;
+    uint64_t                      mFramesPulled; // Since the start. The cache holds the last mCacheFrames of them.
+    bool                          mSourceEnded;
+    size_t                        mDroppedFrames;
+
+  };
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerFanOut__) */
@@ -11,7 +11,9 @@
 
 #include "RealtimeResamplerFilter.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <cassert>
 
 namespace RealtimeResampler {
 
@@ -33,6 +35,10 @@ namespace RealtimeResampler {
     mCutoffToNyquistRatio = ratio;
   }
   
+  void Filter::processRamp(SampleType* samples, size_t numFrames, float startCutoff, float endCutoff){
+    process(samples, numFrames, 0.5f * (startCutoff + endCutoff));
+  }
+  
   SampleType Filter::pitchFactorToCutoff(SampleType pitchFactor){
       return mCutoffToNyquistRatio * mSampleRate / ( 2 * std::max(1.0f, pitchFactor) ) ;
   }
@@ -41,10 +47,9 @@ namespace RealtimeResampler {
   
   IIRFilter::IIRFilter():mQ(Q_MIN){}
 
-  IIRFilter::Biquad::Biquad(size_t maxBufferFrames, int numChannels):
-    mSourceCopy(maxBufferFrames, numChannels, Renderer::BUFFER_FRONT_PADDING),
-    mWorkspace(maxBufferFrames, numChannels, Renderer::BUFFER_FRONT_PADDING),
-    mNumChannels(numChannels)
+  IIRFilter::Biquad::Biquad(int numChannels):
+    mNumChannels(numChannels),
+    mHistory(HISTORY_FRAMES * 2, numChannels)
   {}
   
   void IIRFilter::bltCoef( SampleType b2, SampleType b1, SampleType b0, SampleType a1, SampleType a0, SampleType fc, SampleType *coef_out)
@@ -59,43 +64,108 @@ namespace RealtimeResampler {
       coef_out[4] = (a0 - a1*sf + sfsq)/norm;
   }
 
-  void IIRFilter::Biquad::filter(Buffer* buffer){
+  SharedTable IIRFilter::lowPassCoefTable(SampleType q){
+    double params[] = {q};
+    return SharedTable("IIRFilter::lowPassCoef", params, 1, (COEF_TABLE_INTERVALS + 1) * 5, buildLowPassCoefTable);
+  }
   
-    size_t bufferLengthBytes = buffer->length * mNumChannels * sizeof(SampleType);
+  void IIRFilter::buildLowPassCoefTable(SampleType* values, size_t numValues, const double* params){
+    double a1 = 1.0 / params[0];
+    // At a cutoff of zero the filter is all feedback: y[n] = 2y[n-1] - y[n-2]
+    SampleType* coef = values;
+    coef[0] = coef[1] = coef[2] = 0;
+    coef[3] = -2;
+    coef[4] = 1;
+    // The rest as bltCoef(0, 0, 1, 1/q, 1, fc), in double precision, with a sample rate of one
+    for (int i = 1; i <= COEF_TABLE_INTERVALS; i++) {
+      coef = values + i * 5;
+      double fc = 0.5 * i / COEF_TABLE_INTERVALS;
+      double sf = 1.0 / tan(M_PI * fc);
+      double sfsq = sf * sf;
+      double norm = 1 + a1 * sf + sfsq;
+      coef[0] = 1 / norm;
+      coef[1] = 2 / norm;
+      coef[2] = 1 / norm;
+      coef[3] = 2 * (1 - sfsq) / norm;
+      coef[4] = (1 - a1 * sf + sfsq) / norm;
+    }
+  }
   
-    // Keep a copy of the clean source. An IIR filter builds each sample using a combination of delayed
-    // source samples, and delayed feedback samples
-    
-    // copy the last two frames from the last call to the beginning of the source buffer
-    if(mSourceCopy.length > 0){
-      memcpy(mSourceCopy.getDataPtr(), mSourceCopy.getDataPtr() + mNumChannels * mSourceCopy.length, Renderer::BUFFER_FRONT_PADDING * mNumChannels * sizeof(SampleType));
-    }
-    // copy in the incoming data
-    memcpy(mSourceCopy.getStartPtr(), buffer->getStartPtr(), bufferLengthBytes);
-    // set the mSource buffer length to match the incoming data length
-    mSourceCopy.length = buffer->length;
-    
-    // copy the last two frames of the workspace on to the beginning of the workspace
-    if(mWorkspace.length > 0){
-      memcpy(mWorkspace.getDataPtr(), mWorkspace.getDataPtr() + mNumChannels * mWorkspace.length, Renderer::BUFFER_FRONT_PADDING * mNumChannels * sizeof(SampleType));
+  void IIRFilter::lowPassCoef(const SharedTable& table, SampleType fc, SampleType *coef_out){
+    lowPassCoef(table, fc, mSampleRate, coef_out);
+  }
+  
+  void IIRFilter::lowPassCoef(const SharedTable& table, SampleType fc, float sampleRate, SampleType *coef_out){
+    SampleType position = std::min(std::max(fc * 2 * COEF_TABLE_INTERVALS / sampleRate, 0.0f), (SampleType)COEF_TABLE_INTERVALS);
+    int index = std::min((int)position, COEF_TABLE_INTERVALS - 1);
+    SampleType frac = position - index;
+    const SampleType* lower = table.getValues() + index * 5;
+    const SampleType* upper = lower + 5;
+    for (int i = 0; i < 5; i++) {
+      coef_out[i] = lower[i] + frac * (upper[i] - lower[i]);
+    }
+  }
+
+  void IIRFilter::Biquad::filter(SampleType* samples, size_t numFrames){
+    filterFrames<false>(samples, numFrames, 0);
+  }
+  
+  void IIRFilter::Biquad::filterRamp(SampleType* samples, size_t numFrames, const SampleType* endCoef){
+    if (numFrames > 0) {
+      SampleType coefDelta[5];
+      for (int i = 0; i < 5; i++) {
+        coefDelta[i] = (endCoef[i] - mCoef[i]) / numFrames;
+      }
+      filterFrames<true>(samples, numFrames, coefDelta);
     }
-    mWorkspace.length = buffer->length;
+    memcpy(mCoef, endCoef, sizeof(mCoef));
+  }
+
+  template<bool Ramp>
+  void IIRFilter::Biquad::filterFrames(SampleType* samples, size_t numFrames, const SampleType* coefDelta){
+  
+    // An IIR filter builds each sample using a combination of delayed source samples, and delayed feedback samples.
+    // Only the most recent two of each are needed, so they're kept in locals while filtering in place.
     
+    SampleType* history = mHistory.getStartPtr();
     
     for (int chan = 0; chan < mNumChannels; chan++) {
-      SampleType* in = mSourceCopy.getStartPtr() + chan;
-      SampleType* out = mWorkspace.getStartPtr() + chan;
+      SampleType x1 = history[chan];
+      SampleType x2 = history[mNumChannels + chan];
+      SampleType y1 = history[2 * mNumChannels + chan];
+      SampleType y2 = history[3 * mNumChannels + chan];
+      SampleType c0 = mCoef[0], c1 = mCoef[1], c2 = mCoef[2], c3 = mCoef[3], c4 = mCoef[4];
+      SampleType* sample = samples + chan;
     
-      for (int i = 0; i < buffer->length ; i++) {
-        *out = *(in)*mCoef[0] + *(in-mNumChannels)*mCoef[1] + *(in-2*mNumChannels)*mCoef[2] - *(out-mNumChannels)*mCoef[3] - *(out-2*mNumChannels)*mCoef[4];
-        in += mNumChannels;
-        out += mNumChannels;
+      for (int i = 0; i < numFrames ; i++) {
+        if (Ramp) {
+          c0 += coefDelta[0];
+          c1 += coefDelta[1];
+          c2 += coefDelta[2];
+          c3 += coefDelta[3];
+          c4 += coefDelta[4];
+        }
+        SampleType x = *sample;
+        SampleType y = x*c0 + x1*c1 + x2*c2 - y1*c3 - y2*c4;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        *sample = y;
+        sample += mNumChannels;
       }
+      
+      history[chan] = x1;
+      history[mNumChannels + chan] = x2;
+      history[2 * mNumChannels + chan] = y1;
+      history[3 * mNumChannels + chan] = y2;
     }
-    
-    memcpy(buffer->getStartPtr(), mWorkspace.getStartPtr(), bufferLengthBytes);
    
   }
+  
+  void IIRFilter::Biquad::reset(){
+    mHistory.clear();
+  }
 
   //////////////////////////////////////////
   /// Two-Pole low-pass filter
@@ -103,30 +173,290 @@ namespace RealtimeResampler {
   
   
   LPF12::LPF12():
-    mBiquad(0,1)
+    mBiquad(1),
+    mCoefTable(lowPassCoefTable(mQ))
   {}
   
   void LPF12::init(float sampleRate, size_t maxBufferFrames, int numChannels){
     Filter::init(sampleRate, maxBufferFrames, numChannels);
     mCutoff = mSampleRate / 2;
-    mBiquad = Biquad(maxBufferFrames, numChannels);
+    mBiquad = Biquad(numChannels);
     
-    bltCoef(0, 0, 1, 1.0f/mQ, 1, mCutoff, &mBiquad.mCoef[0]);
+    lowPassCoef(mCoefTable, mCutoff, &mBiquad.mCoef[0]);
     
   }
   
-  void LPF12::process(Buffer* buffer, float cutoff){
+  void LPF12::process(SampleType* samples, size_t numFrames, float cutoff){
     if(cutoff != mCutoff){
       mCutoff = cutoff;
-      bltCoef(0, 0, 1, 1.0f/mQ, 1, mCutoff, &mBiquad.mCoef[0]);
+      lowPassCoef(mCoefTable, mCutoff, &mBiquad.mCoef[0]);
     }
   
-    mBiquad.filter(buffer);
+    mBiquad.filter(samples, numFrames);
+  }
+  
+  void LPF12::processRamp(SampleType* samples, size_t numFrames, float startCutoff, float endCutoff){
+    if(startCutoff == endCutoff){
+      process(samples, numFrames, endCutoff);
+      return;
+    }
+    if(startCutoff != mCutoff){
+      lowPassCoef(mCoefTable, startCutoff, &mBiquad.mCoef[0]);
+    }
+    SampleType endCoef[5];
+    lowPassCoef(mCoefTable, endCutoff, endCoef);
+    mBiquad.filterRamp(samples, numFrames, endCoef);
+    mCutoff = endCutoff;
   }
   
   void LPF12::reset(){
-    mBiquad.mSourceCopy.clear();
-    mBiquad.mWorkspace.clear();
+    mBiquad.reset();
+  }
+  
+  //////////////////////////////////////////
+  /// Cascade of second order sections
+  //////////////////////////////////////////
+  
+  BiquadCascade::BiquadCascade():
+    mNumSections(0),
+    mNumChannels(1),
+    mState(0, 1)
+  {
+    memset(mCoef, 0, sizeof(mCoef));
+  }
+  
+  void BiquadCascade::init(int numSections, int numChannels){
+    assert(numSections > 0 && numSections <= MAX_SECTIONS);
+    mNumSections = numSections;
+    mNumChannels = numChannels;
+    mState = Buffer(numSections * 2, numChannels);
+  }
+  
+  void BiquadCascade::setCoefficients(int section, const SampleType* coefficients){
+    memcpy(mCoef[section], coefficients, sizeof(mCoef[section]));
+  }
+  
+  void BiquadCascade::reset(){
+    mState.clear();
+  }
+  
+  void BiquadCascade::process(SampleType* samples, size_t numFrames){
+    switch (mNumSections) {
+      case 1: processSections<1, false>(samples, numFrames, 0); break;
+      case 2: processSections<2, false>(samples, numFrames, 0); break;
+      case 3: processSections<3, false>(samples, numFrames, 0); break;
+      case 4: processSections<4, false>(samples, numFrames, 0); break;
+    }
+  }
+  
+  void BiquadCascade::processRamp(SampleType* samples, size_t numFrames, const SampleType (*endCoefficients)[NUM_COEFFICIENTS]){
+    if (numFrames > 0) {
+      SampleType coefDelta[MAX_SECTIONS][NUM_COEFFICIENTS];
+      for (int section = 0; section < mNumSections; section++) {
+        for (int i = 0; i < NUM_COEFFICIENTS; i++) {
+          coefDelta[section][i] = (endCoefficients[section][i] - mCoef[section][i]) / numFrames;
+        }
+      }
+      switch (mNumSections) {
+        case 1: processSections<1, true>(samples, numFrames, coefDelta); break;
+        case 2: processSections<2, true>(samples, numFrames, coefDelta); break;
+        case 3: processSections<3, true>(samples, numFrames, coefDelta); break;
+        case 4: processSections<4, true>(samples, numFrames, coefDelta); break;
+      }
+    }
+    for (int section = 0; section < mNumSections; section++) {
+      setCoefficients(section, endCoefficients[section]);
+    }
+  }
+  
+  template<int NumSections, bool Ramp>
+  void BiquadCascade::processSections(SampleType* samples, size_t numFrames, const SampleType (*coefDelta)[NUM_COEFFICIENTS]){
+  
+    SampleType* state = mState.getStartPtr();
+    int channel = 0;
+    
+  #if defined(REALTIME_RESAMPLER_SIMD)
+    // A vector of channels at a time
+    for (; channel + SimdFloat::WIDTH <= mNumChannels; channel += SimdFloat::WIDTH) {
+      SimdFloat::Type s1[NumSections], s2[NumSections], coef[NumSections][NUM_COEFFICIENTS], delta[NumSections][NUM_COEFFICIENTS];
+      for (int section = 0; section < NumSections; section++) {
+        s1[section] = SimdFloat::load(state + (section * 2) * mNumChannels + channel);
+        s2[section] = SimdFloat::load(state + (section * 2 + 1) * mNumChannels + channel);
+        for (int k = 0; k < NUM_COEFFICIENTS; k++) {
+          coef[section][k] = SimdFloat::set1(mCoef[section][k]);
+          delta[section][k] = SimdFloat::set1(Ramp ? coefDelta[section][k] : 0);
+        }
+      }
+      SampleType* frame = samples + channel;
+      for (size_t i = 0; i < numFrames; i++, frame += mNumChannels) {
+        SimdFloat::Type x = SimdFloat::load(frame);
+        for (int section = 0; section < NumSections; section++) {
+          SimdFloat::Type* c = coef[section];
+          if (Ramp) {
+            for (int k = 0; k < NUM_COEFFICIENTS; k++) {
+              c[k] = SimdFloat::add(c[k], delta[section][k]);
+            }
+          }
+          SimdFloat::Type y = SimdFloat::add(SimdFloat::mul(c[0], x), s1[section]);
+          s1[section] = SimdFloat::add(SimdFloat::sub(SimdFloat::mul(c[1], x), SimdFloat::mul(c[3], y)), s2[section]);
+          s2[section] = SimdFloat::sub(SimdFloat::mul(c[2], x), SimdFloat::mul(c[4], y));
+          x = y;
+        }
+        SimdFloat::store(frame, x);
+      }
+      for (int section = 0; section < NumSections; section++) {
+        SimdFloat::store(state + (section * 2) * mNumChannels + channel, s1[section]);
+        SimdFloat::store(state + (section * 2 + 1) * mNumChannels + channel, s2[section]);
+      }
+    }
+  #endif
+  
+    // The remaining channels one at a time
+    for (; channel < mNumChannels; channel++) {
+      SampleType s1[NumSections], s2[NumSections], coef[NumSections][NUM_COEFFICIENTS], delta[NumSections][NUM_COEFFICIENTS];
+      for (int section = 0; section < NumSections; section++) {
+        s1[section] = state[(section * 2) * mNumChannels + channel];
+        s2[section] = state[(section * 2 + 1) * mNumChannels + channel];
+        for (int k = 0; k < NUM_COEFFICIENTS; k++) {
+          coef[section][k] = mCoef[section][k];
+          delta[section][k] = Ramp ? coefDelta[section][k] : 0;
+        }
+      }
+      SampleType* frame = samples + channel;
+      for (size_t i = 0; i < numFrames; i++, frame += mNumChannels) {
+        SampleType x = *frame;
+        for (int section = 0; section < NumSections; section++) {
+          SampleType* c = coef[section];
+          if (Ramp) {
+            for (int k = 0; k < NUM_COEFFICIENTS; k++) {
+              c[k] += delta[section][k];
+            }
+          }
+          SampleType y = c[0] * x + s1[section];
+          s1[section] = c[1] * x - c[3] * y + s2[section];
+          s2[section] = c[2] * x - c[4] * y;
+          x = y;
+        }
+        *frame = x;
+      }
+      for (int section = 0; section < NumSections; section++) {
+        state[(section * 2) * mNumChannels + channel] = s1[section];
+        state[(section * 2 + 1) * mNumChannels + channel] = s2[section];
+      }
+    }
+  }
+  
+  //////////////////////////////////////////
+  /// Butterworth low-pass filters
+  //////////////////////////////////////////
+  
+  ButterworthLPF::ButterworthLPF(int order):
+    mNumSections(order / 2),
+    mCutoff(0)
+  {
+    assert(order % 2 == 0 && mNumSections > 0 && mNumSections <= BiquadCascade::MAX_SECTIONS);
+    // The poles of a Butterworth filter are evenly spaced around the unit circle. Each conjugate pair is one section.
+    for (int section = 0; section < mNumSections; section++) {
+      mSectionQ[section] = 1.0 / (2 * cos(M_PI * (2 * section + 1) / (2 * order)));
+      mSectionCoefTables[section] = lowPassCoefTable(mSectionQ[section]);
+    }
+  }
+  
+  void ButterworthLPF::init(float sampleRate, size_t maxBufferFrames, int numChannels){
+    Filter::init(sampleRate, maxBufferFrames, numChannels);
+    mCutoff = mSampleRate / 2;
+    mCascade.init(mNumSections, numChannels);
+    updateCoefficients();
+  }
+  
+  void ButterworthLPF::updateCoefficients(){
+    for (int section = 0; section < mNumSections; section++) {
+      SampleType coef[BiquadCascade::NUM_COEFFICIENTS];
+      lowPassCoef(mSectionCoefTables[section], mCutoff, coef);
+      mCascade.setCoefficients(section, coef);
+    }
+  }
+  
+  void ButterworthLPF::process(SampleType* samples, size_t numFrames, float cutoff){
+    if(cutoff != mCutoff){
+      mCutoff = cutoff;
+      updateCoefficients();
+    }
+    mCascade.process(samples, numFrames);
+  }
+  
+  void ButterworthLPF::processRamp(SampleType* samples, size_t numFrames, float startCutoff, float endCutoff){
+    if(startCutoff == endCutoff){
+      process(samples, numFrames, endCutoff);
+      return;
+    }
+    if(startCutoff != mCutoff){
+      mCutoff = startCutoff;
+      updateCoefficients();
+    }
+    SampleType endCoef[BiquadCascade::MAX_SECTIONS][BiquadCascade::NUM_COEFFICIENTS];
+    for (int section = 0; section < mNumSections; section++) {
+      lowPassCoef(mSectionCoefTables[section], endCutoff, endCoef[section]);
+    }
+    mCascade.processRamp(samples, numFrames, endCoef);
+    mCutoff = endCutoff;
+  }
+  
+  void ButterworthLPF::reset(){
+    mCascade.reset();
+  }
+  
+  //////////////////////////////////////////
+  /// Filter chains
+  //////////////////////////////////////////
+  
+  DynamicFilterChain::DynamicFilterChain():
+    mCount(0),
+    mSampleRate(0),
+    mMaxBufferFrames(0),
+    mNumChannels(0)
+  {}
+  
+  void DynamicFilterChain::init(float sampleRate, size_t maxBufferFrames, int numChannels){
+    mSampleRate = sampleRate;
+    mMaxBufferFrames = maxBufferFrames;
+    mNumChannels = numChannels;
+    for(int i = 0; i < mCount; i++){
+      mFilters[i]->init(mSampleRate, mMaxBufferFrames, mNumChannels);
+    }
+  }
+  
+  void DynamicFilterChain::process(SampleType* samples, size_t numFrames, SampleType startPitch, SampleType endPitch){
+    for(int i = 0; i < mCount; i++){
+      mFilters[i]->processRamp(samples, numFrames, mFilters[i]->pitchFactorToCutoff(startPitch), mFilters[i]->pitchFactorToCutoff(endPitch));
+    }
+  }
+  
+  void DynamicFilterChain::reset(){
+    for(int i = 0; i < mCount; i++){
+      mFilters[i]->reset();
+    }
+  }
+  
+  void DynamicFilterChain::add(Filter* filter){
+    if (mCount < MAX_FILTERS) {
+      mFilters[mCount++] = filter;
+      filter->init(mSampleRate, mMaxBufferFrames, mNumChannels);
+    }
+  }
+  
+  void DynamicFilterChain::initFilter(Filter* filter) const{
+    filter->init(mSampleRate, mMaxBufferFrames, mNumChannels);
+  }
+  
+  void DynamicFilterChain::addInitialized(Filter* filter){
+    if (mCount < MAX_FILTERS) {
+      mFilters[mCount++] = filter;
+    }
+  }
+  
+  void DynamicFilterChain::clear(){
+    mCount = 0;
   }
 
 }
@@ -13,7 +13,9 @@
 #define __EliasResamplerDemo__RealtimeResamplerFilter__
 
 #include <stdio.h>
-#include "RealtimeResampler.h"
+#include "RealtimeResamplerBuffer.h"
+#include "RealtimeResamplerSIMD.h"
+#include "RealtimeResamplerSharedTable.h"
 
 
 namespace RealtimeResampler {
@@ -24,7 +26,8 @@ namespace RealtimeResampler {
 
   class Filter{
   
-    friend class Renderer;
+    friend class DynamicFilterChain;
+    template<class> friend class StaticFilterChain;
     
     public:
     
@@ -41,7 +44,14 @@ namespace RealtimeResampler {
       void                      setCutoffToNyquistRatio(float);
     
     protected:
-      virtual void              process(Buffer* buffer, float cutoff) = 0;
+      virtual void              process(SampleType* samples, size_t numFrames, float cutoff) = 0;
+    
+      /*!
+        Filter with the cutoff moving from startCutoff at the start of the block to endCutoff at the end, to follow a pitch glide.
+        Filters that can't move their cutoff within a block use the cutoff halfway through.
+      */
+    
+      virtual void              processRamp(SampleType* samples, size_t numFrames, float startCutoff, float endCutoff);
       virtual void              init(float sampleRate, size_t maxBufferFrames, int numChannels);
     
       /*!
@@ -82,19 +92,49 @@ namespace RealtimeResampler {
   
     protected:
     
+      /*!
+        Direct form I biquad that filters in place. The only state kept between calls is the last HISTORY_FRAMES input and
+        output frames, so the memory used depends on the channel count, not the block size.
+      */
+    
       class Biquad {
       
       public:
-        Biquad(size_t maxBufferFrames, int numChannels);
+        Biquad(int numChannels);
+        enum {                  HISTORY_FRAMES = 2 }; // the frames from the previous buffer the filter needs
         int                     mNumChannels;
-        Buffer                  mSourceCopy;
-        Buffer                  mWorkspace;
+        Buffer                  mHistory; // [x1, x2, y1, y2][channel]
         float                   mCoef[5];
-        void                    filter(Buffer* buffer);
+        void                    filter(SampleType* samples, size_t numFrames);
+        // Filter with the coefficients moving linearly from mCoef to endCoef across the block. mCoef ends up at endCoef.
+        void                    filterRamp(SampleType* samples, size_t numFrames, const SampleType* endCoef);
+        void                    reset();
+      
+      protected:
+        template<bool Ramp>
+        void                    filterFrames(SampleType* samples, size_t numFrames, const SampleType* coefDelta);
 
       };
     
       void                      bltCoef( SampleType b2, SampleType b1, SampleType b0, SampleType a1, SampleType a0, SampleType fc, SampleType *coef_out);
+      void                      lowPassCoef(const SharedTable& table, SampleType fc, SampleType *coef_out);
+      static void               buildLowPassCoefTable(SampleType* values, size_t numValues, const double* params);
+    
+    public:
+    
+      /*!
+        Low-pass coefficients for every cutoff from 0 to nyquist, COEF_TABLE_INTERVALS apart, for one Q. Cutoffs are relative to
+        the sample rate, so filters share the table whatever their sample rate. lowPassCoef interpolates linearly between
+        entries, which keeps the filter stable and the DC gain at one, and saves a tanf and a division each time the cutoff moves.
+        The static version is for code that runs its own biquads, such as VoiceBank.
+      */
+    
+      enum {                    COEF_TABLE_INTERVALS = 1024 };
+      static SharedTable        lowPassCoefTable(SampleType q);
+      static void               lowPassCoef(const SharedTable& table, SampleType fc, float sampleRate, SampleType *coef_out);
+    
+    protected:
+    
       SampleType                mQ;
     
   };
@@ -113,15 +153,189 @@ namespace RealtimeResampler {
     
     protected:
     
-      void                      process(Buffer* buffer, float cutoff);
+      void                      process(SampleType* samples, size_t numFrames, float cutoff);
+      void                      processRamp(SampleType* samples, size_t numFrames, float startCutoff, float endCutoff);
       virtual void              reset();
     
       Biquad                    mBiquad;
+      SharedTable               mCoefTable;
       SampleType                mCutoff;
   
   };
- 
   
+  //////////////////////////////////////////
+  /// Cascade of second order sections
+  //////////////////////////////////////////
+  
+  /*!
+    Runs up to MAX_SECTIONS biquads in series over interleaved frames, in place, in a single pass. Each section is in transposed
+    direct form II, so the only state is two values per section per channel, and it stays in registers for the length of the
+    block. With enough channels the channels are processed a vector at a time.
+   
+    Coefficients are [b0, b1, b2, a1, a2], normalized so that a0 is 1, as produced by IIRFilter::bltCoef.
+  */
+  
+  class BiquadCascade{
+  public:
+  
+    enum {                      MAX_SECTIONS = 4, NUM_COEFFICIENTS = 5 };
+  
+    BiquadCascade();
+  
+    void                        init(int numSections, int numChannels);
+    void                        setCoefficients(int section, const SampleType* coefficients);
+    void                        process(SampleType* samples, size_t numFrames);
+    // Process with every section's coefficients moving linearly to endCoefficients across the block, where they end up.
+    void                        processRamp(SampleType* samples, size_t numFrames, const SampleType (*endCoefficients)[NUM_COEFFICIENTS]);
+    void                        reset();
+  
+  protected:
+  
+    template<int NumSections, bool Ramp>
+    void                        processSections(SampleType* samples, size_t numFrames, const SampleType (*coefDelta)[NUM_COEFFICIENTS]);
+  
+    int                         mNumSections;
+    int                         mNumChannels;
+    SampleType                  mCoef[MAX_SECTIONS][NUM_COEFFICIENTS];
+    Buffer                      mState; // [section][2][channel]
+  
+  };
+  
+  //////////////////////////////////////////
+  /// Butterworth low-pass filters
+  //////////////////////////////////////////
+  
+  /*!
+    Even order Butterworth low-pass, from 2 to 2 * BiquadCascade::MAX_SECTIONS poles, run as one BiquadCascade. Steeper filters
+    can put their cutoff closer to nyquist for the same amount of anti-aliasing (see setCutoffToNyquistRatio).
+  */
+  
+  class ButterworthLPF : public IIRFilter{
+  
+    public:
+    
+      ButterworthLPF(int order);
+    
+      void                      init(float sampleRate, size_t maxBufferFrames, int numChannels);
+    
+    protected:
+    
+      void                      process(SampleType* samples, size_t numFrames, float cutoff);
+      void                      processRamp(SampleType* samples, size_t numFrames, float startCutoff, float endCutoff);
+      virtual void              reset();
+      void                      updateCoefficients();
+    
+      BiquadCascade             mCascade;
+      int                       mNumSections;
+      SampleType                mSectionQ[BiquadCascade::MAX_SECTIONS];
+      SharedTable               mSectionCoefTables[BiquadCascade::MAX_SECTIONS];
+      SampleType                mCutoff;
+  
+  };
+  
+  //////////////////////////////////////////
+  /// Four-Pole low-pass filter
+  //////////////////////////////////////////
+  
+  class LPF24 : public ButterworthLPF{
+    public:
+      LPF24() : ButterworthLPF(4){}
+  };
+  
+  //////////////////////////////////////////
+  /// Eight-Pole low-pass filter
+  //////////////////////////////////////////
+  
+  class LPF48 : public ButterworthLPF{
+    public:
+      LPF48() : ButterworthLPF(8){}
+  };
+  
+  //////////////////////////////////////////
+  /// Filter chains
+  //////////////////////////////////////////
+  
+  /*
+    BasicRenderer runs its anti-aliasing filters through a FilterChain. A chain is initialized with the renderer's format,
+    filters a run of interleaved source frames in place given the pitch the first and last of them will be read at, and can
+    be reset. The filters' cutoffs follow the pitch from one to the other across the run.
+  */
+  
+  /*!
+    No anti-aliasing at all. Useful when pitching down, or when the source is already band-limited.
+  */
+  
+  class NoFilters{
+  public:
+    void                        init(float sampleRate, size_t maxBufferFrames, int numChannels){}
+    void                        process(SampleType* samples, size_t numFrames, SampleType startPitch, SampleType endPitch){}
+    void                        reset(){}
+    bool                        isEmpty() const { return true; }
+  };
+  
+  /*!
+    Up to MAX_FILTERS filters chosen at runtime. This is what Renderer uses.
+  */
+  
+  class DynamicFilterChain{
+  public:
+  
+    DynamicFilterChain();
+  
+    enum {                      MAX_FILTERS = 10 };
+  
+    void                        init(float sampleRate, size_t maxBufferFrames, int numChannels);
+    void                        process(SampleType* samples, size_t numFrames, SampleType startPitch, SampleType endPitch);
+    void                        reset();
+  
+    // Append a filter. Filters beyond MAX_FILTERS are ignored.
+    void                        add(Filter* filter);
+    // Initialize a filter with the chain's settings, then append it with addInitialized, which doesn't allocate. For adding
+    // a filter made on another thread.
+    void                        initFilter(Filter* filter) const;
+    void                        addInitialized(Filter* filter);
+    void                        clear();
+    bool                        isEmpty() const { return mCount == 0; }
+  
+  protected:
+  
+    Filter*                     mFilters[MAX_FILTERS];
+    int                         mCount;
+    float                       mSampleRate;
+    size_t                      mMaxBufferFrames;
+    int                         mNumChannels;
+  
+  };
+  
+  /*!
+    A single filter of a type known at compile time, owned by the chain.
+  */
+  
+  template<class FilterType>
+  class StaticFilterChain{
+  public:
+  
+    void                        init(float sampleRate, size_t maxBufferFrames, int numChannels){
+      filter().init(sampleRate, maxBufferFrames, numChannels);
+    }
+  
+    void                        process(SampleType* samples, size_t numFrames, SampleType startPitch, SampleType endPitch){
+      filter().processRamp(samples, numFrames, filter().pitchFactorToCutoff(startPitch), filter().pitchFactorToCutoff(endPitch));
+    }
+  
+    void                        reset(){
+      filter().reset();
+    }
+  
+    bool                        isEmpty() const { return false; }
+  
+  protected:
+  
+    Filter&                     filter(){ return mFilter; }
+  
+    FilterType                  mFilter;
+  
+  };
 
 }
 
@@ -10,31 +10,95 @@
 //
 
 #include "RealtimeResamplerInterpolator.h"
+#include "RealtimeResamplerSIMD.h"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
 
 namespace RealtimeResampler{
+
+#if defined(REALTIME_RESAMPLER_SIMD)
+
+  //////////////////////////////////////////
+  /// Vector helpers
+  //////////////////////////////////////////
+  
+  /*
+    The mono vector kernels evaluate SimdFloat::WIDTH output frames at once. They perform exactly the same float operations,
+    in the same order, as the scalar loops that handle the leftover frames, so their output is bit-identical to the scalar
+    reference. The only exception is when the compiler is allowed to contract the scalar code into fused multiply-adds
+    (-ffp-contract=fast with FMA enabled), in which case the two may differ by up to 1 ULP per multiply-add, which bounds
+    the difference at 3 ULP for the Hermite kernel, and less for the others.
+  */
+  
+  // Load the sample [tap] frames away from each of the next SimdFloat::WIDTH positions of a mono input
+  static inline SimdFloat::Type gatherTap(const SampleType* inputBuffer, const int* indexBuffer, int tap){
+  #if defined(REALTIME_RESAMPLER_AVX2)
+    return _mm256_i32gather_ps(inputBuffer + tap, _mm256_loadu_si256((const __m256i*)indexBuffer), sizeof(SampleType));
+  #else
+    return _mm_setr_ps(
+      inputBuffer[indexBuffer[0] + tap],
+      inputBuffer[indexBuffer[1] + tap],
+      inputBuffer[indexBuffer[2] + tap],
+      inputBuffer[indexBuffer[3] + tap]
+    );
+  #endif
+  }
+  
+  // Load the four frames surrounding each of the next SimdFloat::WIDTH positions of a mono input, one register per tap
+  static inline void gatherNeighborhood(const SampleType* inputBuffer, const int* indexBuffer, SimdFloat::Type* taps){
+  #if defined(REALTIME_RESAMPLER_AVX2)
+    for (int tap = 0; tap < 4; tap++) {
+      taps[tap] = gatherTap(inputBuffer, indexBuffer, tap - 1);
+    }
+  #else
+    // Load each four-frame neighborhood whole and transpose them into one register per tap.
+    __m128 frame0 = _mm_loadu_ps(inputBuffer + indexBuffer[0] - 1);
+    __m128 frame1 = _mm_loadu_ps(inputBuffer + indexBuffer[1] - 1);
+    __m128 frame2 = _mm_loadu_ps(inputBuffer + indexBuffer[2] - 1);
+    __m128 frame3 = _mm_loadu_ps(inputBuffer + indexBuffer[3] - 1);
+    _MM_TRANSPOSE4_PS(frame0, frame1, frame2, frame3);
+    taps[0] = frame0;
+    taps[1] = frame1;
+    taps[2] = frame2;
+    taps[3] = frame3;
+  #endif
+  }
+  
+#endif
   
   //////////////////////////////////////////
   /// Linear Interpolator
   //////////////////////////////////////////
   
   
-  void LinearInterpolator::process(SampleType* inputBuffer, SampleType* outputBuffer, SampleType* interpolationBuffer, size_t numFrames, int hop){
+  void LinearInterpolator::processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames){
+    
+    size_t i = 0;
+    
+  #if defined(REALTIME_RESAMPLER_SIMD)
+    for (; i + SimdFloat::WIDTH <= numFrames; i += SimdFloat::WIDTH) {
+      SimdFloat::Type sample1 = gatherTap(inputBuffer, indexBuffer + i, 0);
+      SimdFloat::Type sample2 = gatherTap(inputBuffer, indexBuffer + i, 1);
+      SimdFloat::Type interpolationCoefficient = SimdFloat::load(fractionBuffer + i);
+      SimdFloat::store(outputBuffer + i, SimdFloat::add(sample1, SimdFloat::mul(SimdFloat::sub(sample2, sample1), interpolationCoefficient)));
+    }
+  #endif
     
-    for (int i = 0; i < numFrames; i++) {
+    for (; i < numFrames; i++) {
     
-      int integerPartOfInterpolationBuffer = (int)interpolationBuffer[i];
-      SampleType interpolationCoefficient = interpolationBuffer[i] - integerPartOfInterpolationBuffer;
+      SampleType interpolationCoefficient = fractionBuffer[i];
     
       // The first frame of the interpolated pair
-      int sampleIndex1 = integerPartOfInterpolationBuffer * hop;
+      int sampleIndex1 = indexBuffer[i];
       
       // The second frame of the interpolated pair.
-      int sampleIndex2 = sampleIndex1 + hop;
+      int sampleIndex2 = sampleIndex1 + 1;
       
       SampleType sample1 = inputBuffer[sampleIndex1];
       SampleType sample2 = inputBuffer[sampleIndex2];
       
-      outputBuffer[i * hop] = sample1 + (sample2 - sample1) * interpolationCoefficient ;
+      outputBuffer[i] = sample1 + (sample2 - sample1) * interpolationCoefficient ;
       
     }
   }
@@ -43,26 +107,43 @@ namespace RealtimeResampler{
   /// Watte tri-linear Interpolator
   //////////////////////////////////////////
  
-  void WatteTrilinearInterpolator::process(SampleType* inputBuffer, SampleType* outputBuffer, SampleType* interpolationBuffer, size_t numFrames, int hop){
+  void WatteTrilinearInterpolator::processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames){
+    
+    size_t i = 0;
+    
+  #if defined(REALTIME_RESAMPLER_SIMD)
+    const SimdFloat::Type half = SimdFloat::set1(0.5f);
+    const SimdFloat::Type threeHalves = SimdFloat::set1(1.5f);
+    for (; i + SimdFloat::WIDTH <= numFrames; i += SimdFloat::WIDTH) {
+      SimdFloat::Type frames[4];
+      gatherNeighborhood(inputBuffer, indexBuffer + i, frames);
+      SimdFloat::Type t = SimdFloat::load(fractionBuffer + i);
+      SimdFloat::Type ym1py2 = SimdFloat::add(frames[0], frames[3]);
+      SimdFloat::Type c0 = frames[1];
+      SimdFloat::Type c1 = SimdFloat::sub(SimdFloat::mul(threeHalves, frames[2]), SimdFloat::mul(half, SimdFloat::add(frames[1], ym1py2)));
+      SimdFloat::Type c2 = SimdFloat::mul(half, SimdFloat::sub(SimdFloat::sub(ym1py2, frames[1]), frames[2]));
+      SimdFloat::store(outputBuffer + i, SimdFloat::add(SimdFloat::mul(SimdFloat::add(SimdFloat::mul(c2, t), c1), t), c0));
+    }
+  #endif
     
     SampleType frame0Sample, frame1Sample, frame2Sample, frame3Sample;
     
-    for (int i = 0; i < numFrames; i++) {
+    for (; i < numFrames; i++) {
     
-      int interpPosition = (int)interpolationBuffer[i];
-      SampleType t = interpolationBuffer[i] - interpPosition;
+      int interpPosition = indexBuffer[i];
+      SampleType t = fractionBuffer[i];
     
-      frame0Sample = inputBuffer[ (interpPosition - 1) * hop];
-      frame1Sample = inputBuffer[ (interpPosition)  * hop];
-      frame2Sample = inputBuffer[ (interpPosition + 1) * hop];
-      frame3Sample = inputBuffer[ (interpPosition + 2) * hop];
+      frame0Sample = inputBuffer[ interpPosition - 1];
+      frame1Sample = inputBuffer[ interpPosition];
+      frame2Sample = inputBuffer[ interpPosition + 1];
+      frame3Sample = inputBuffer[ interpPosition + 2];
   
       // 4-point, 2nd-order Watte tri-linear (x-form)
       float ym1py2 = frame0Sample + frame3Sample;
       float c0 = frame1Sample;
-      float c1 = 3/2.0*frame2Sample - 1/2.0*(frame1Sample+ym1py2);
-      float c2 = 1/2.0*(ym1py2-frame1Sample-frame2Sample);
-      outputBuffer[i * hop] = (c2*t+c1)*t+c0;
+      float c1 = 1.5F*frame2Sample - .5F*(frame1Sample+ym1py2);
+      float c2 = .5F*(ym1py2-frame1Sample-frame2Sample);
+      outputBuffer[i] = (c2*t+c1)*t+c0;
 
     }
   }
@@ -71,29 +152,256 @@ namespace RealtimeResampler{
   /// Hermite Interpolator
   //////////////////////////////////////////
   
-  void HermiteInterpolator::process(SampleType* inputBuffer, SampleType* outputBuffer, SampleType* interpolationBuffer, size_t numFrames, int hop){
+  void HermiteInterpolator::processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames){
+  
+    size_t i = 0;
+    
+  #if defined(REALTIME_RESAMPLER_SIMD)
+    const SimdFloat::Type half = SimdFloat::set1(.5F);
+    const SimdFloat::Type threeHalves = SimdFloat::set1(1.5F);
+    const SimdFloat::Type two = SimdFloat::set1(2);
+    const SimdFloat::Type fiveHalves = SimdFloat::set1(2.5F);
+    for (; i + SimdFloat::WIDTH <= numFrames; i += SimdFloat::WIDTH) {
+      SimdFloat::Type frames[4];
+      gatherNeighborhood(inputBuffer, indexBuffer + i, frames);
+      SimdFloat::Type t = SimdFloat::load(fractionBuffer + i);
+      SimdFloat::Type c0 = frames[1];
+      SimdFloat::Type c1 = SimdFloat::mul(half, SimdFloat::sub(frames[2], frames[0]));
+      SimdFloat::Type c2 = SimdFloat::sub(SimdFloat::add(SimdFloat::sub(frames[0], SimdFloat::mul(fiveHalves, frames[1])), SimdFloat::mul(two, frames[2])), SimdFloat::mul(half, frames[3]));
+      SimdFloat::Type c3 = SimdFloat::add(SimdFloat::mul(half, SimdFloat::sub(frames[3], frames[0])), SimdFloat::mul(threeHalves, SimdFloat::sub(frames[1], frames[2])));
+      SimdFloat::Type result = SimdFloat::add(SimdFloat::mul(SimdFloat::add(SimdFloat::mul(SimdFloat::add(SimdFloat::mul(c3, t), c2), t), c1), t), c0);
+      SimdFloat::store(outputBuffer + i, result);
+    }
+  #endif
   
     SampleType frame0Sample, frame1Sample, frame2Sample, frame3Sample;
     
-    for (int i = 0; i < numFrames; i++) {
+    for (; i < numFrames; i++) {
     
-      int interpPosition = (int)interpolationBuffer[i];
-      SampleType t = interpolationBuffer[i] - interpPosition;
+      int interpPosition = indexBuffer[i];
+      SampleType t = fractionBuffer[i];
       
-      frame0Sample = inputBuffer[ (interpPosition - 1) * hop];
-      frame1Sample = inputBuffer[ (interpPosition)  * hop];
-      frame2Sample = inputBuffer[ (interpPosition + 1) * hop];
-      frame3Sample = inputBuffer[ (interpPosition + 2) * hop];
+      frame0Sample = inputBuffer[ interpPosition - 1];
+      frame1Sample = inputBuffer[ interpPosition];
+      frame2Sample = inputBuffer[ interpPosition + 1];
+      frame3Sample = inputBuffer[ interpPosition + 2];
     
       float c0 = frame1Sample;
       float c1 = .5F * (frame2Sample - frame0Sample);
       float c2 = frame0Sample - (2.5F * frame1Sample) + (2 * frame2Sample) - (.5F * frame3Sample);
       float c3 = (.5F * (frame3Sample - frame0Sample)) + (1.5F * (frame1Sample - frame2Sample));
-      outputBuffer[i * hop] = (((((c3 * t) + c2) * t) + c1) * t) + c0;
+      outputBuffer[i] = (((((c3 * t) + c2) * t) + c1) * t) + c0;
+
+    }
+  }
 
+  //////////////////////////////////////////
+  /// Windowed sinc Interpolator
+  //////////////////////////////////////////
+  
+  /*
+    The table holds one kernel per pitch band. Each kernel is numPhases + 1 rows of numTaps weights, one row per fractional
+    position from 0 to 1 inclusive, so that the last phase has a neighbour to interpolate towards. Rows are padded to a
+    multiple of the SIMD width so they all start on a vector boundary.
+  */
+  
+  static const int SINC_BANDS_PER_OCTAVE = 4;
+  static const double SINC_STOPBAND_ATTENUATION = 72; // dB
+  static const double SINC_KAISER_BETA = 0.1102 * (SINC_STOPBAND_ATTENUATION - 8.7);
+  
+  double besselI0(double x){
+    double sum = 1;
+    double term = 1;
+    for (int k = 1; k < 50; k++) {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+      if (term < sum * 1e-12) {
+        break;
+      }
+    }
+    return sum;
+  }
+  
+  static int sincRowStride(int numTaps){
+  #if defined(REALTIME_RESAMPLER_SIMD)
+    return (numTaps + SimdFloat::WIDTH - 1) / SimdFloat::WIDTH * SimdFloat::WIDTH;
+  #else
+    return numTaps;
+  #endif
+  }
+  
+  SincInterpolator::SincInterpolator(int numTaps, int numPhases, float maxPitch):
+    mNumTaps(numTaps),
+    mNumPhases(numPhases),
+    mRowStride(sincRowStride(numTaps)),
+    mNumBands(1 + (int)ceil(SINC_BANDS_PER_OCTAVE * log2(std::max(1.0f, maxPitch)) - 1e-6)),
+    mBand(0)
+  {
+    assert(numTaps >= MIN_TAPS && numTaps <= MAX_TAPS && numTaps % 2 == 0);
+    assert(numPhases > 0);
+    double params[] = {(double)mNumTaps, (double)mNumPhases, (double)mNumBands, (double)mRowStride};
+    mTable = SharedTable("SincInterpolator", params, 4, (size_t)mNumBands * (mNumPhases + 1) * mRowStride, buildTable);
+    mBand = mTable.getValues();
+  }
+  
+  void SincInterpolator::buildTable(SampleType* values, size_t numValues, const double* params){
+  
+    int numTaps = (int)params[0];
+    int numPhases = (int)params[1];
+    int numBands = (int)params[2];
+    int rowStride = (int)params[3];
+    int firstTap = 1 - numTaps / 2;
+    double halfLength = numTaps / 2;
+    double windowNormalization = 1.0 / besselI0(SINC_KAISER_BETA);
+    
+    // A finite kernel can't cut off instantly. Estimate the width of its transition band (in cycles per source frame), and
+    // put the cutoff far enough below the target Nyquist frequency that the stop band starts at it. The cutoff is never
+    // lowered by more than an octave, so very short kernels at high pitches will let some aliasing through.
+    double transitionWidth = (SINC_STOPBAND_ATTENUATION - 7.95) / (14.36 * (numTaps - 1));
+    
+    for (int band = 0; band < numBands; band++) {
+      double nyquist = 0.5 / pow(2.0, (double)band / SINC_BANDS_PER_OCTAVE);
+      double cutoff = 2 * std::max(nyquist - transitionWidth / 2, nyquist / 2); // relative to the source Nyquist frequency
+      for (int phase = 0; phase <= numPhases; phase++) {
+        SampleType* row = values + ((size_t)band * (numPhases + 1) + phase) * rowStride;
+        double t = (double)phase / numPhases;
+        double weights[MAX_TAPS];
+        double sum = 0;
+        for (int tap = 0; tap < numTaps; tap++) {
+          double x = tap + firstTap - t;
+          double r = x / halfLength;
+          double window = besselI0(SINC_KAISER_BETA * sqrt(std::max(0.0, 1 - r * r))) * windowNormalization;
+          double sinc = x == 0 ? 1 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+          weights[tap] = cutoff * sinc * window;
+          sum += weights[tap];
+        }
+        // unity gain at DC
+        for (int tap = 0; tap < numTaps; tap++) {
+          row[tap] = weights[tap] / sum;
+        }
+      }
+    }
+  }
+  
+  void SincInterpolator::setPitch(SampleType pitch){
+    int band = 0;
+    if (pitch > 1) {
+      // round up, so the cutoff is never above the new Nyquist frequency
+      band = std::min(mNumBands - 1, (int)ceil(SINC_BANDS_PER_OCTAVE * log2(pitch) - 1e-4));
+    }
+    mBand = mTable.getValues() + (size_t)band * (mNumPhases + 1) * mRowStride;
+  }
+  
+  int SincInterpolator::getNumTaps() const{
+    return mNumTaps;
+  }
+  
+  int SincInterpolator::getLeftSupport() const{
+    return mNumTaps / 2 - 1;
+  }
+  
+  int SincInterpolator::getRightSupport() const{
+    return mNumTaps / 2;
+  }
+  
+  void SincInterpolator::weights(SampleType t, SampleType* w) const{
+    SampleType position = t * mNumPhases;
+    int phase = std::min((int)position, mNumPhases - 1);
+    SampleType f = position - phase;
+    const SampleType* row0 = mBand + phase * mRowStride;
+    const SampleType* row1 = row0 + mRowStride;
+    for (int tap = 0; tap < mNumTaps; tap++) {
+      w[tap] = row0[tap] + f * (row1[tap] - row0[tap]);
+    }
+  }
+  
+  void SincInterpolator::process(SampleType* inputBuffer, SampleType* outputBuffer, int* indexBuffer, SampleType* fractionBuffer, size_t numFrames, int numChannels){
+    interpolateFrames(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, numChannels);
+  }
+  
+  void SincInterpolator::interpolateFrames(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels){
+    if (numChannels == 1) {
+      processMono(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames);
+    }else if (numChannels == 2) {
+      processFrameMajor<2>(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, 2);
+    }else{
+      processFrameMajor<0>(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, numChannels);
+    }
+  }
+  
+  // With a single channel the taps are contiguous, so interpolate between the two phases and take the dot product with the
+  // input in one pass, a vector of taps at a time.
+  void SincInterpolator::processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames){
+  
+    const int firstTap = 1 - mNumTaps / 2;
+    
+    for (size_t i = 0; i < numFrames; i++) {
+    
+      SampleType position = fractionBuffer[i] * mNumPhases;
+      int phase = std::min((int)position, mNumPhases - 1);
+      SampleType f = position - phase;
+      const SampleType* row0 = mBand + phase * mRowStride;
+      const SampleType* row1 = row0 + mRowStride;
+      const SampleType* in = inputBuffer + indexBuffer[i] + firstTap;
+      int tap = 0;
+      SampleType sum = 0;
+      
+    #if defined(REALTIME_RESAMPLER_SIMD)
+      SimdFloat::Type fraction = SimdFloat::set1(f);
+      SimdFloat::Type vectorSum = SimdFloat::set1(0);
+      for (; tap + SimdFloat::WIDTH <= mNumTaps; tap += SimdFloat::WIDTH) {
+        SimdFloat::Type w0 = SimdFloat::load(row0 + tap);
+        SimdFloat::Type w = SimdFloat::add(w0, SimdFloat::mul(fraction, SimdFloat::sub(SimdFloat::load(row1 + tap), w0)));
+        vectorSum = SimdFloat::add(vectorSum, SimdFloat::mul(w, SimdFloat::load(in + tap)));
+      }
+      sum = SimdFloat::sum(vectorSum);
+    #endif
+    
+      for (; tap < mNumTaps; tap++) {
+        sum += (row0[tap] + f * (row1[tap] - row0[tap])) * in[tap];
+      }
+      outputBuffer[i] = sum;
+    }
+  }
+  
+  // Same layout as the frame-major polynomial kernels: compute the weights once per frame, then apply them across channels.
+  template<int NumChannels>
+  void SincInterpolator::processFrameMajor(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels){
+  
+    const int channels = NumChannels ? NumChannels : numChannels;
+    const int firstTap = 1 - mNumTaps / 2;
+    SampleType w[MAX_TAPS];
+    
+    for (size_t i = 0; i < numFrames; i++) {
+    
+      weights(fractionBuffer[i], w);
+      
+      const SampleType* in = inputBuffer + (indexBuffer[i] + firstTap) * channels;
+      SampleType* out = outputBuffer + i * channels;
+      int channel = 0;
+      
+    #if defined(REALTIME_RESAMPLER_SIMD)
+      if (NumChannels == 0) {
+        for (; channel + SimdFloat::WIDTH <= channels; channel += SimdFloat::WIDTH) {
+          SimdFloat::Type sum = SimdFloat::set1(0);
+          for (int tap = 0; tap < mNumTaps; tap++) {
+            sum = SimdFloat::add(sum, SimdFloat::mul(SimdFloat::set1(w[tap]), SimdFloat::load(in + tap * channels + channel)));
+          }
+          SimdFloat::store(out + channel, sum);
+        }
+      }
+    #endif
+    
+      for (; channel < channels; channel++) {
+        SampleType sum = 0;
+        for (int tap = 0; tap < mNumTaps; tap++) {
+          sum += w[tap] * in[tap * channels + channel];
+        }
+        out[channel] = sum;
+      }
     }
   }
 
  
 
-}
\ No newline at end of file
+}
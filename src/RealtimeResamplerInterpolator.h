@@ -13,10 +13,14 @@
 #define __EliasResamplerDemo__Interpolator__
 
 #include <stdio.h>
-#include "RealtimeResampler.h"
+#include "RealtimeResamplerBuffer.h"
+#include "RealtimeResamplerSIMD.h"
+#include "RealtimeResamplerSharedTable.h"
 
 namespace RealtimeResampler {
 
+  // Zeroth order modified Bessel function of the first kind, for Kaiser windows
+  double                        besselI0(double x);
 
   //////////////////////////////////////////
   /// Abstract Interpolator delegate class.
@@ -24,35 +28,340 @@ namespace RealtimeResampler {
 
   class Interpolator{
   
-    friend class Renderer;
+    friend class DynamicInterpolator;
     
   public:
   
     virtual ~Interpolator(){};
   
+    /*!
+      Called by the renderer before each call to process with the highest pitch the coming frames will be rendered at. Band-limited
+      interpolators use it to lower their cutoff when pitching up. The rest ignore it.
+    */
+  
+    virtual void setPitch(SampleType pitch){}
+  
+    /*!
+      How many frames before and after the interpolated frame the interpolator reads. For example a four point interpolator
+      between frames 0 and 1 reads frames -1 through 2, so its left support is 1 and its right support is 2. The renderer pads its
+      source buffers by this much. The defaults cover any four point interpolator.
+    */
+  
+    virtual int getLeftSupport() const { return 1; }
+    virtual int getRightSupport() const { return 2; }
+  
+    /*!
+      The weights of the getLeftSupport() + getRightSupport() + 1 frames around a fractional position t, starting
+      getLeftSupport() frames before it, at the current pitch. At steady whole number and power of two ratios the renderer
+      works these out once per distinct fraction and applies them itself (see interpolatePeriodic). Interpolators that can't
+      be described by their weights return false, and are always called through process.
+    */
+  
+    virtual bool kernelWeights(SampleType t, SampleType* w) const { return false; }
+  
   protected:
   
     /*!
-      Interpolate between input frames. It's up to the caller to determine what the output buffer size will be. The interpolator may look
-      as far ahead of the inputBuffer pointer as inputBuffer[-(mBufferFrontPadding*hop)].
+      Interpolate between interleaved input frames, all channels at once. It's up to the caller to determine what the output buffer
+      size will be. The interpolator may read getLeftSupport() frames before each indexed frame and getRightSupport() frames after it.
       
-      The interpolationBuffer variable is a list of positions we need to interpolate. It is the sample length as the outputBuffer number
-      of frames. For example, for a four-frame mono input sped up for a factor of 1.5, the contents of the interpolationBuffer would be [0, 1.5, 3]
+      The positions to interpolate are split into the integer frame (indexBuffer) and the fractional distance to the next frame
+      (fractionBuffer). Both have the same number of entries as the outputBuffer has frames. For example, for a four-frame mono input
+      sped up by a factor of 1.5, the contents of the indexBuffer would be [0, 1, 3] and the fractionBuffer [0, 0.5, 0]
      
     */
   
-    virtual void process(SampleType* inputBuffer, SampleType* outputBuffer, SampleType* interpolationBuffer, size_t numFrames, int hop) = 0;
+    virtual void process(SampleType* inputBuffer, SampleType* outputBuffer, int* indexBuffer, SampleType* fractionBuffer, size_t numFrames, int numChannels) = 0;
     
     
+  };
+  
+  //////////////////////////////////////////
+  /// Interpolation kernels
+  //////////////////////////////////////////
+  
+  /*!
+    With more than one channel, walk the positions once, frame by frame. The kernel's weights depend only on the fractional
+    position, so they're computed once per frame and applied to every channel. The channels of each source frame are contiguous,
+    so the inner loop runs across channels, a vector's worth at a time where possible.
+    
+    NumChannels is the channel count if it's known at compile time, in which case the channel loop unrolls completely, or 0 to
+    use numChannels.
+  */
+  
+  template<class Kernel, int NumChannels>
+  inline void processFrameMajor(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels){
+    
+    const int channels = NumChannels ? NumChannels : numChannels;
+    SampleType w[Kernel::NUM_TAPS];
+    
+    for (size_t i = 0; i < numFrames; i++) {
+    
+      Kernel::weights(fractionBuffer[i], w);
+      
+      const SampleType* firstTap = inputBuffer + (indexBuffer[i] + Kernel::FIRST_TAP) * channels;
+      SampleType* out = outputBuffer + i * channels;
+      int channel = 0;
+      
+    #if defined(REALTIME_RESAMPLER_SIMD)
+      if (NumChannels == 0 || NumChannels >= SimdFloat::WIDTH) {
+        for (; channel + SimdFloat::WIDTH <= channels; channel += SimdFloat::WIDTH) {
+          SimdFloat::Type sum = SimdFloat::mul(SimdFloat::set1(w[0]), SimdFloat::load(firstTap + channel));
+          for (int tap = 1; tap < Kernel::NUM_TAPS; tap++) {
+            sum = SimdFloat::add(sum, SimdFloat::mul(SimdFloat::set1(w[tap]), SimdFloat::load(firstTap + tap * channels + channel)));
+          }
+          SimdFloat::store(out + channel, sum);
+        }
+      }
+    #endif
+    
+      for (; channel < channels; channel++) {
+        SampleType sum = w[0] * firstTap[channel];
+        for (int tap = 1; tap < Kernel::NUM_TAPS; tap++) {
+          sum += w[tap] * firstTap[tap * channels + channel];
+        }
+        out[channel] = sum;
+      }
+    }
+  }
+  
+  /*!
+    Interpolate at a steady ratio, where the positions cycle through numPhases fractions. Frame i is centred on input frame
+    phaseIndex[i % numPhases] + (i / numPhases) * step, and uses row i % numPhases of phaseWeights, numTaps weights starting
+    firstTap frames from that frame. A phase whose weights are a lone one just copies the frame, so a whole number ratio
+    read from a whole frame is a strided copy.
+  */
+  
+  template<int NumChannels>
+  inline void interpolatePeriodic(const SampleType* inputBuffer, SampleType* outputBuffer, const int* phaseIndex, const SampleType* phaseWeights, int numTaps, int firstTap, int numPhases, int step, size_t numFrames, int numChannels){
+  
+    const int channels = NumChannels ? NumChannels : numChannels;
+    const size_t inputStride = (size_t)step * channels;
+    const size_t outputStride = (size_t)numPhases * channels;
+    
+    for (int phase = 0; phase < numPhases && phase < (int)numFrames; phase++) {
+    
+      const SampleType* w = phaseWeights + phase * numTaps;
+      const SampleType* firstFrame = inputBuffer + (phaseIndex[phase] + firstTap) * channels;
+      SampleType* out = outputBuffer + phase * channels;
+      size_t phaseFrames = (numFrames - phase + numPhases - 1) / numPhases;
+      
+      int copyTap = -1;
+      for (int tap = 0; tap < numTaps; tap++) {
+        if (w[tap] == 1) {
+          copyTap = copyTap == -1 ? tap : -2;
+        }else if (w[tap] != 0) {
+          copyTap = -2;
+        }
+      }
+      if (copyTap >= 0) {
+        const SampleType* in = firstFrame + copyTap * channels;
+        for (size_t i = 0; i < phaseFrames; i++, in += inputStride, out += outputStride) {
+          for (int channel = 0; channel < channels; channel++) {
+            out[channel] = in[channel];
+          }
+        }
+        continue;
+      }
+      
+    #if defined(REALTIME_RESAMPLER_SIMD)
+      // A long mono kernel's taps are contiguous, so take the dot product a vector of taps at a time
+      if (channels == 1 && numTaps >= SimdFloat::WIDTH) {
+        for (size_t i = 0; i < phaseFrames; i++, firstFrame += inputStride, out += outputStride) {
+          SimdFloat::Type vectorSum = SimdFloat::set1(0);
+          int tap = 0;
+          for (; tap + SimdFloat::WIDTH <= numTaps; tap += SimdFloat::WIDTH) {
+            vectorSum = SimdFloat::add(vectorSum, SimdFloat::mul(SimdFloat::load(w + tap), SimdFloat::load(firstFrame + tap)));
+          }
+          SampleType sum = SimdFloat::sum(vectorSum);
+          for (; tap < numTaps; tap++) {
+            sum += w[tap] * firstFrame[tap];
+          }
+          *out = sum;
+        }
+        continue;
+      }
+    #endif
+      
+      for (size_t i = 0; i < phaseFrames; i++, firstFrame += inputStride, out += outputStride) {
+        int channel = 0;
+      #if defined(REALTIME_RESAMPLER_SIMD)
+        if (NumChannels == 0 || NumChannels >= SimdFloat::WIDTH) {
+          for (; channel + SimdFloat::WIDTH <= channels; channel += SimdFloat::WIDTH) {
+            SimdFloat::Type sum = SimdFloat::mul(SimdFloat::set1(w[0]), SimdFloat::load(firstFrame + channel));
+            for (int tap = 1; tap < numTaps; tap++) {
+              sum = SimdFloat::add(sum, SimdFloat::mul(SimdFloat::set1(w[tap]), SimdFloat::load(firstFrame + tap * channels + channel)));
+            }
+            SimdFloat::store(out + channel, sum);
+          }
+        }
+      #endif
+        for (; channel < channels; channel++) {
+          SampleType sum = w[0] * firstFrame[channel];
+          for (int tap = 1; tap < numTaps; tap++) {
+            sum += w[tap] * firstFrame[tap * channels + channel];
+          }
+          out[channel] = sum;
+        }
+      }
+    }
+  }
+  
+  /*!
+    Interpolate at a fixed ratio of sourceSteps / outputSteps. Positions are counted in steps of 1 / outputSteps of a frame,
+    and the first is phase steps past input frame index. Each output frame moves sourceSteps steps on, and uses the row of
+    phaseWeights for its phase, numTaps weights starting firstTap frames from its frame. Only integers are involved in
+    walking the positions.
+  */
+  
+  template<int NumChannels>
+  inline void interpolateFixedRatio(const SampleType* inputBuffer, SampleType* outputBuffer, int index, int phase, int sourceSteps, int outputSteps, const SampleType* phaseWeights, int numTaps, int firstTap, size_t numFrames, int numChannels){
+  
+    const int channels = NumChannels ? NumChannels : numChannels;
+    const int wholeFrames = sourceSteps / outputSteps;
+    const int remainingSteps = sourceSteps % outputSteps;
+    
+    for (size_t i = 0; i < numFrames; i++) {
+    
+      const SampleType* w = phaseWeights + phase * numTaps;
+      const SampleType* firstFrame = inputBuffer + (index + firstTap) * channels;
+      SampleType* out = outputBuffer + i * channels;
+      int channel = 0;
+      
+    #if defined(REALTIME_RESAMPLER_SIMD)
+      if (channels == 1 && numTaps >= SimdFloat::WIDTH) {
+        // A long mono kernel's taps are contiguous, so take the dot product a vector of taps at a time
+        SimdFloat::Type vectorSum = SimdFloat::set1(0);
+        int tap = 0;
+        for (; tap + SimdFloat::WIDTH <= numTaps; tap += SimdFloat::WIDTH) {
+          vectorSum = SimdFloat::add(vectorSum, SimdFloat::mul(SimdFloat::load(w + tap), SimdFloat::load(firstFrame + tap)));
+        }
+        SampleType sum = SimdFloat::sum(vectorSum);
+        for (; tap < numTaps; tap++) {
+          sum += w[tap] * firstFrame[tap];
+        }
+        *out = sum;
+        channel = 1;
+      }else if (NumChannels == 0 || NumChannels >= SimdFloat::WIDTH) {
+        for (; channel + SimdFloat::WIDTH <= channels; channel += SimdFloat::WIDTH) {
+          SimdFloat::Type sum = SimdFloat::mul(SimdFloat::set1(w[0]), SimdFloat::load(firstFrame + channel));
+          for (int tap = 1; tap < numTaps; tap++) {
+            sum = SimdFloat::add(sum, SimdFloat::mul(SimdFloat::set1(w[tap]), SimdFloat::load(firstFrame + tap * channels + channel)));
+          }
+          SimdFloat::store(out + channel, sum);
+        }
+      }
+    #endif
+    
+      for (; channel < channels; channel++) {
+        SampleType sum = w[0] * firstFrame[channel];
+        for (int tap = 1; tap < numTaps; tap++) {
+          sum += w[tap] * firstFrame[tap * channels + channel];
+        }
+        out[channel] = sum;
+      }
+      
+      index += wholeFrames;
+      phase += remainingSteps;
+      if (phase >= outputSteps) {
+        phase -= outputSteps;
+        index++;
+      }
+    }
+  }
+  
+  /*!
+    Pick the best kernel for the channel count. Mono input uses the kernel's vectorized across-frames implementation. Stereo
+    is common enough to get its own unrolled loop when the channel count is only known at runtime.
+  */
+  
+  template<class Kernel, int NumChannels>
+  inline void interpolateFrames(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels){
+    if (NumChannels == 1 || (NumChannels == 0 && numChannels == 1)) {
+      Kernel::processMono(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames);
+    }else if (NumChannels == 0 && numChannels == 2) {
+      processFrameMajor<Kernel, 2>(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, 2);
+    }else{
+      processFrameMajor<Kernel, NumChannels>(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, numChannels);
+    }
+  }
+  
+  /*!
+    Base class for the built-in interpolators. Kernel supplies NUM_TAPS, FIRST_TAP, weights() and processMono(). The
+    virtual process() is there for the runtime-polymorphic Renderer. BasicRenderer calls interpolate() directly, so
+    the channel count can be fixed at compile time.
+  */
+  
+  template<class Kernel>
+  class KernelInterpolator : public Interpolator{
+  public:
+  
+    int                         getLeftSupport() const { return -Kernel::FIRST_TAP; }
+    int                         getRightSupport() const { return Kernel::NUM_TAPS - 1 + Kernel::FIRST_TAP; }
+  
+    template<int NumChannels>
+    static inline void          interpolate(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels){
+      interpolateFrames<Kernel, NumChannels>(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, numChannels);
+    }
+  
+    bool                        kernelWeights(SampleType t, SampleType* w) const { Kernel::weights(t, w); return true; }
+  
+  protected:
+  
+    void                        process(SampleType* inputBuffer, SampleType* outputBuffer, int* indexBuffer, SampleType* fractionBuffer, size_t numFrames, int numChannels){
+      interpolateFrames<Kernel, 0>(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, numChannels);
+    }
+  
+  };
+  
+  //////////////////////////////////////////
+  /// Adapter that lets BasicRenderer use any Interpolator chosen at runtime
+  //////////////////////////////////////////
+  
+  class DynamicInterpolator{
+  public:
+  
+    DynamicInterpolator():mInterpolator(0){}
+  
+    void                        setInterpolator(Interpolator* interpolator){ mInterpolator = interpolator; }
+  
+    inline void                 setPitch(SampleType pitch){ mInterpolator->setPitch(pitch); }
+  
+    int                         getLeftSupport() const { return mInterpolator ? mInterpolator->getLeftSupport() : 0; }
+    int                         getRightSupport() const { return mInterpolator ? mInterpolator->getRightSupport() : 0; }
+    bool                        kernelWeights(SampleType t, SampleType* w) const { return mInterpolator->kernelWeights(t, w); }
+  
+    template<int NumChannels>
+    inline void                 interpolate(SampleType* inputBuffer, SampleType* outputBuffer, int* indexBuffer, SampleType* fractionBuffer, size_t numFrames, int numChannels){
+      mInterpolator->process(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, numChannels);
+    }
+  
+  protected:
+  
+    Interpolator*               mInterpolator;
+  
   };
 
   //////////////////////////////////////////
   /// Linear Interpolator
   //////////////////////////////////////////
 
-  class LinearInterpolator : public Interpolator{
-  protected:
-    void process(SampleType* inputBuffer, SampleType* outputBuffer, SampleType* interpolationBuffer, size_t numFrames, int hop);
+  class LinearInterpolator : public KernelInterpolator<LinearInterpolator>{
+  public:
+  
+    enum {                      NUM_TAPS = 2, FIRST_TAP = 0 };
+    
+    /*!
+      The weight of each of the NUM_TAPS frames surrounding a position, starting FIRST_TAP frames from the integer part of the position.
+    */
+    
+    static inline void          weights(SampleType t, SampleType* w){
+      w[0] = 1 - t;
+      w[1] = t;
+    }
+    
+    static void                 processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames);
+    
   };
   
   
@@ -75,9 +384,21 @@ namespace RealtimeResampler {
   /// Watte tri-linear Interpolator
   //////////////////////////////////////////
   
-  class WatteTrilinearInterpolator : public Interpolator{
-  protected:
-    void process(SampleType* inputBuffer, SampleType* outputBuffer, SampleType* interpolationBuffer, size_t numFrames, int hop);
+  class WatteTrilinearInterpolator : public KernelInterpolator<WatteTrilinearInterpolator>{
+  public:
+  
+    enum {                      NUM_TAPS = 4, FIRST_TAP = -1 };
+    
+    static inline void          weights(SampleType t, SampleType* w){
+      SampleType halfTSquared = .5F * t * t;
+      w[0] = halfTSquared - .5F * t;
+      w[1] = 1 - .5F * t - halfTSquared;
+      w[2] = 1.5F * t - halfTSquared;
+      w[3] = w[0];
+    }
+    
+    static void                 processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames);
+    
   };
   
  
@@ -85,9 +406,85 @@ namespace RealtimeResampler {
   /// Hermite Interpolator
   //////////////////////////////////////////
 
-  class HermiteInterpolator : public Interpolator{
+  class HermiteInterpolator : public KernelInterpolator<HermiteInterpolator>{
+  public:
+  
+    enum {                      NUM_TAPS = 4, FIRST_TAP = -1 };
+    
+    static inline void          weights(SampleType t, SampleType* w){
+      w[0] = t * (-.5F + t * (1 - .5F * t));
+      w[1] = 1 + t * t * (-2.5F + 1.5F * t);
+      w[2] = t * (.5F + t * (2 - 1.5F * t));
+      w[3] = t * t * (-.5F + .5F * t);
+    }
+    
+    static void                 processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames);
+    
+  };
+  
+  //////////////////////////////////////////
+  /// Windowed sinc Interpolator
+  //////////////////////////////////////////
+  
+  /*!
+    Polyphase Kaiser-windowed sinc interpolation. Much higher quality than the polynomial interpolators, and band-limited:
+    when pitching up, the kernel's cutoff drops below the new Nyquist frequency, so no separate anti-aliasing filter is needed.
+   
+    numTaps is the length of the kernel, an even number from 8 to 64. Longer kernels have a sharper cutoff and cost more.
+    numPhases is the number of fractional positions the kernel is precomputed at; positions between them are linearly
+    interpolated. The kernels are precomputed for pitches up to maxPitch, in quarter octave steps. Above maxPitch the
+    kernel for maxPitch is used.
+   
+    The tables are shared by all SincInterpolators with the same settings, so only the first one pays for building them.
+   
+    The kernel reaches numTaps / 2 - 1 frames before and numTaps / 2 frames after the interpolated position. The renderer's
+    source buffer length must be at least numTaps / 2 frames.
+  */
+  
+  class SincInterpolator : public Interpolator{
+  public:
+  
+    enum {                      MIN_TAPS = 8, MAX_TAPS = 64 };
+  
+    SincInterpolator(int numTaps = 32, int numPhases = 256, float maxPitch = 4);
+  
+    void                        setPitch(SampleType pitch);
+  
+    int                         getNumTaps() const;
+  
+    int                         getLeftSupport() const;
+    int                         getRightSupport() const;
+  
+    // The kernel weights for a fractional position at the current pitch. For testing.
+    void                        weights(SampleType t, SampleType* w) const;
+  
+    bool                        kernelWeights(SampleType t, SampleType* w) const { weights(t, w); return true; }
+  
+    template<int NumChannels>
+    inline void                 interpolate(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels){
+      interpolateFrames(inputBuffer, outputBuffer, indexBuffer, fractionBuffer, numFrames, NumChannels ? NumChannels : numChannels);
+    }
+  
   protected:
-    void process(SampleType* inputBuffer, SampleType* outputBuffer, SampleType* interpolationBuffer, size_t numFrames, int hop);
+  
+    void                        process(SampleType* inputBuffer, SampleType* outputBuffer, int* indexBuffer, SampleType* fractionBuffer, size_t numFrames, int numChannels);
+  
+    void                        interpolateFrames(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels);
+  
+    template<int NumChannels>
+    void                        processFrameMajor(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames, int numChannels);
+  
+    void                        processMono(const SampleType* inputBuffer, SampleType* outputBuffer, const int* indexBuffer, const SampleType* fractionBuffer, size_t numFrames);
+  
+    static void                 buildTable(SampleType* values, size_t numValues, const double* params);
+  
+    int                         mNumTaps;
+    int                         mNumPhases;
+    int                         mRowStride; // floats per phase, rounded up so every phase starts on a SIMD boundary
+    int                         mNumBands;
+    SharedTable                 mTable;
+    const SampleType*           mBand; // the first phase of the kernel for the current pitch
+  
   };
  
 }
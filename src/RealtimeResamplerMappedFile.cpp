@@ -0,0 +1,283 @@
+//
+//  RealtimeResamplerMappedFile.cpp
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "RealtimeResamplerMappedFile.h"
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace RealtimeResampler {
+
+  static const int WAVE_FORMAT_PCM = 1;
+  static const int WAVE_FORMAT_IEEE_FLOAT = 3;
+  static const int WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+  static inline uint16_t readLE16(const uint8_t* bytes){
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+  }
+
+  static inline uint32_t readLE32(const uint8_t* bytes){
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+  }
+
+  static size_t pageSize(){
+    static const size_t size = (size_t)sysconf(_SC_PAGESIZE);
+    return size;
+  }
+
+  // Convert numSamples samples, stepping through the input and output by the given numbers of samples
+  static void convertSamples(const uint8_t* input, MappedFileSource::SampleFormat format, int inputStride, SampleType* output, int outputStride, size_t numSamples){
+    switch (format) {
+      case MappedFileSource::INT16:
+        for (size_t i = 0; i < numSamples; i++, input += 2 * inputStride, output += outputStride) {
+          *output = (int16_t)readLE16(input) * (SampleType)(1.0 / 32768);
+        }
+        break;
+      case MappedFileSource::INT24:
+        // Shift the sample to the top of 32 bits to sign extend it
+        for (size_t i = 0; i < numSamples; i++, input += 3 * inputStride, output += outputStride) {
+          int32_t sample = (int32_t)(((uint32_t)input[0] << 8) | ((uint32_t)input[1] << 16) | ((uint32_t)input[2] << 24));
+          *output = sample * (SampleType)(1.0 / 2147483648.0);
+        }
+        break;
+      case MappedFileSource::FLOAT32:
+        for (size_t i = 0; i < numSamples; i++, input += 4 * inputStride, output += outputStride) {
+          float sample;
+          memcpy(&sample, input, sizeof(float));
+          *output = sample;
+        }
+        break;
+    }
+  }
+
+  MappedFileSource::MappedFileSource() :
+    mMapping(0),
+    mMappingBytes(0),
+    mData(0),
+    mFormat(INT16),
+    mBytesPerSample(0),
+    mNumChannels(0),
+    mNumFrames(0),
+    mFileSampleRate(0),
+    mPosition(0),
+    mPitch(1),
+    mReadAheadFrames(READ_AHEAD_FRAMES),
+    mAdvisedEnd(0),
+    mReleasedEnd(0)
+  {}
+
+  MappedFileSource::~MappedFileSource(){
+    close();
+  }
+
+  bool MappedFileSource::openWav(const char* path){
+    if (!map(path)) {
+      return false;
+    }
+
+    // Find the format and data chunks, skipping any others
+    const uint8_t* bytes = mMapping;
+    if (mMappingBytes < 12 || memcmp(bytes, "RIFF", 4) || memcmp(bytes + 8, "WAVE", 4)) {
+      close();
+      return false;
+    }
+    int formatTag = 0, numChannels = 0, bitsPerSample = 0;
+    uint32_t sampleRate = 0;
+    size_t dataOffset = 0, dataBytes = 0;
+    bool foundFormat = false, foundData = false;
+    size_t offset = 12;
+    while (offset + 8 <= mMappingBytes && !foundData) {
+      size_t chunkBytes = readLE32(bytes + offset + 4);
+      const uint8_t* chunk = bytes + offset + 8;
+      // A file cut short, or written without going back to fill in the size, has less than the size says
+      size_t bytesPresent = std::min(chunkBytes, mMappingBytes - offset - 8);
+      if (!memcmp(bytes + offset, "fmt ", 4) && bytesPresent >= 16) {
+        formatTag = readLE16(chunk);
+        numChannels = readLE16(chunk + 2);
+        sampleRate = readLE32(chunk + 4);
+        bitsPerSample = readLE16(chunk + 14);
+        // The real format is the first two bytes of the subformat GUID
+        if (formatTag == WAVE_FORMAT_EXTENSIBLE && bytesPresent >= 26) {
+          formatTag = readLE16(chunk + 24);
+        }
+        foundFormat = true;
+      }else if (!memcmp(bytes + offset, "data", 4)) {
+        dataOffset = offset + 8;
+        dataBytes = bytesPresent;
+        foundData = true;
+      }
+      // chunks are padded to an even length
+      offset += 8 + chunkBytes + (chunkBytes & 1);
+    }
+
+    SampleFormat format;
+    if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 16) {
+      format = INT16;
+    }else if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 24) {
+      format = INT24;
+    }else if (formatTag == WAVE_FORMAT_IEEE_FLOAT && bitsPerSample == 32) {
+      format = FLOAT32;
+    }else{
+      close();
+      return false;
+    }
+    if (!foundFormat || !foundData || !setData(dataOffset, dataBytes, format, numChannels)) {
+      close();
+      return false;
+    }
+    mFileSampleRate = (float)sampleRate;
+    return true;
+  }
+
+  bool MappedFileSource::openRaw(const char* path, SampleFormat format, int numChannels, size_t dataOffset){
+    if (!map(path)) {
+      return false;
+    }
+    if (dataOffset > mMappingBytes || !setData(dataOffset, mMappingBytes - dataOffset, format, numChannels)) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void MappedFileSource::close(){
+    if (mMapping) {
+      munmap(mMapping, mMappingBytes);
+    }
+    mMapping = 0;
+    mMappingBytes = 0;
+    mData = 0;
+    mBytesPerSample = 0;
+    mNumChannels = 0;
+    mNumFrames = 0;
+    mFileSampleRate = 0;
+    mPosition = 0;
+    mAdvisedEnd = 0;
+    mReleasedEnd = 0;
+  }
+
+  bool MappedFileSource::map(const char* path){
+    close();
+    int file = ::open(path, O_RDONLY);
+    if (file < 0) {
+      return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size <= 0) {
+      ::close(file);
+      return false;
+    }
+    // The mapping keeps the file open
+    void* mapping = mmap(0, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    ::close(file);
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+    mMapping = (uint8_t*)mapping;
+    mMappingBytes = (size_t)status.st_size;
+    return true;
+  }
+
+  bool MappedFileSource::setData(size_t dataOffset, size_t dataBytes, SampleFormat format, int numChannels){
+    if (numChannels <= 0) {
+      return false;
+    }
+    mFormat = format;
+    mBytesPerSample = format == INT16 ? 2 : format == INT24 ? 3 : 4;
+    mNumChannels = numChannels;
+    mNumFrames = dataBytes / (mBytesPerSample * numChannels);
+    mData = mMapping + dataOffset;
+    mFileSampleRate = 0;
+    setPosition(0);
+    return true;
+  }
+
+  void MappedFileSource::setPosition(size_t position){
+    mPosition = position;
+    if (!mData) {
+      return;
+    }
+    // Moving back means pages that were let go are wanted again
+    size_t offset = (mData - mMapping) + std::min(position, mNumFrames) * mBytesPerSample * mNumChannels;
+    mReleasedEnd = std::min(mReleasedEnd, offset & ~(pageSize() - 1));
+    adviseReadAhead(true);
+  }
+
+  void MappedFileSource::setPitch(float pitch){
+    mPitch = pitch;
+  }
+
+  void MappedFileSource::setReadAhead(size_t frames){
+    mReadAheadFrames = frames;
+  }
+
+  void MappedFileSource::adviseReadAhead(bool force){
+
+    // Ask for the next stretch once the position is halfway through the one asked for last
+    const size_t frameBytes = mBytesPerSample * mNumChannels;
+    size_t readAheadBytes = std::max((size_t)1, (size_t)(mReadAheadFrames * std::max(mPitch, 0.f))) * frameBytes;
+    size_t offset = (mData - mMapping) + std::min(mPosition, mNumFrames) * frameBytes;
+    if (!force && offset + readAheadBytes / 2 < mAdvisedEnd) {
+      return;
+    }
+    size_t pageStart = offset & ~(pageSize() - 1);
+    size_t end = std::min(offset + readAheadBytes, mMappingBytes);
+    if (end > pageStart) {
+      madvise(mMapping + pageStart, end - pageStart, MADV_WILLNEED);
+    }
+    mAdvisedEnd = offset + readAheadBytes;
+
+    // Let go of the pages that have been played. They stay in the OS's file cache, so if they're wanted again it's
+    // usually without going back to the disk.
+    if (pageStart > mReleasedEnd) {
+      madvise(mMapping + mReleasedEnd, pageStart - mReleasedEnd, MADV_DONTNEED);
+      mReleasedEnd = pageStart;
+    }
+  }
+
+  size_t MappedFileSource::getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels){
+    if (!mData || mPosition >= mNumFrames) {
+      return 0;
+    }
+    adviseReadAhead(false);
+    size_t numFrames = std::min(numFramesRequested, mNumFrames - mPosition);
+    const uint8_t* frames = mData + mPosition * mBytesPerSample * mNumChannels;
+    if (numChannels == mNumChannels) {
+      convertSamples(frames, mFormat, 1, outputBuffer, 1, numFrames * numChannels);
+    }else{
+      // Wrap around the file's channels
+      for (int chan = 0; chan < numChannels; chan++) {
+        convertSamples(frames + (chan % mNumChannels) * mBytesPerSample, mFormat, mNumChannels, outputBuffer + chan, numChannels, numFrames);
+      }
+    }
+    mPosition += numFrames;
+    return numFrames;
+  }
+
+  const SampleType* MappedFileSource::borrowSamples(size_t maxFrames, size_t* numFramesBorrowed, int numChannels){
+    // Only frames that are already SampleTypes, laid out as the renderer wants them, can be read in place
+    if (!mData || mFormat != FLOAT32 || sizeof(SampleType) != sizeof(float) || numChannels != mNumChannels || (uintptr_t)mData % sizeof(SampleType) || mPosition >= mNumFrames) {
+      return 0;
+    }
+    // The frames lent last time are finished with, but not these
+    adviseReadAhead(false);
+    // Lend half a read-ahead at most, so the renderer comes back for more, and the read-ahead keeps up, as it plays
+    size_t readAheadFrames = std::max((size_t)1, (size_t)(mReadAheadFrames * std::max(mPitch, 0.f)));
+    const SampleType* frames = (const SampleType*)mData + mPosition * numChannels;
+    *numFramesBorrowed = std::min(std::min(maxFrames, mNumFrames - mPosition), std::max((size_t)1, readAheadFrames / 2));
+    mPosition += *numFramesBorrowed;
+    return frames;
+  }
+
+}
@@ -0,0 +1,109 @@
+//
+//  RealtimeResamplerMappedFile.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerMappedFile__
+#define __EliasResamplerDemo__RealtimeResamplerMappedFile__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "RealtimeResampler.h"
+
+namespace RealtimeResampler {
+
+  //////////////////////////////////////////
+  /// MappedFileSource class.
+  //////////////////////////////////////////
+
+  /*!
+    Plays a PCM WAV file, or a raw file of interleaved samples, straight from disk. The file is memory-mapped rather than
+    read, so opening it is quick however big it is, and only the parts being played take up memory. Samples are converted
+    to SampleType as they're pulled. 32-bit float files with the renderer's channel count aren't converted at all, and are
+    lent to the renderer to read in place.
+
+    As it plays, the source asks the OS to start reading the next stretch of the file ahead of time, and lets go of the
+    pages it's played, so its memory stays around one read-ahead's worth. A renderer pulls faster the higher its pitch, so
+    tell the source the pitch and the read-ahead covers the same length of time at any pitch. Playing a part of the file
+    that isn't in memory yet still waits on the disk, so set the read-ahead long enough to cover the disk's latency, and
+    set the position ahead of time when jumping around the file.
+
+    Samples are little-endian, as WAV files are. A file with fewer channels than the renderer is spread across its channels,
+    so a mono file plays in each of them. POSIX only.
+  */
+
+  class MappedFileSource : public AudioSource{
+
+    public:
+
+    enum SampleFormat{ INT16, INT24, FLOAT32 };
+
+    MappedFileSource();
+    ~MappedFileSource();
+
+    // 16 and 24-bit integer or 32-bit float PCM. Returns false, and leaves the source closed, if the file can't be opened
+    // or isn't a WAV file in one of those formats.
+    bool                          openWav(const char* path);
+
+    // A headerless file of interleaved samples, starting dataOffset bytes in
+    bool                          openRaw(const char* path, SampleFormat format, int numChannels, size_t dataOffset = 0);
+
+    void                          close();
+    bool                          isOpen(){ return mData != 0; }
+
+    SampleFormat                  getFormat(){ return mFormat; }
+    int                           getNumChannels(){ return mNumChannels; }
+    size_t                        getNumFrames(){ return mNumFrames; }
+
+    // From the WAV header. 0 for a raw file.
+    float                         getFileSampleRate(){ return mFileSampleRate; }
+
+    // The position of the next frame. Moving it starts reading ahead from the new position straight away.
+    void                          setPosition(size_t position);
+    size_t                        getPosition(){ return mPosition; }
+
+    // The pitch the source is being played at, to scale the read-ahead by
+    void                          setPitch(float pitch);
+
+    // How far ahead to read, in frames of the file at pitch 1. The default is READ_AHEAD_FRAMES.
+    void                          setReadAhead(size_t frames);
+
+    size_t                        getSamples(SampleType* outputBuffer, size_t numFramesRequested, int numChannels);
+    const SampleType*             borrowSamples(size_t maxFrames, size_t* numFramesBorrowed, int numChannels);
+
+    static const size_t           READ_AHEAD_FRAMES = 1 << 16;
+
+    protected:
+
+    MappedFileSource(const MappedFileSource&);
+    MappedFileSource& operator= (const MappedFileSource&);
+
+    bool                          map(const char* path);
+    bool                          setData(size_t dataOffset, size_t dataBytes, SampleFormat format, int numChannels);
+    void                          adviseReadAhead(bool force);
+
+    uint8_t*                      mMapping;
+    size_t                        mMappingBytes;
+    const uint8_t*                mData; // The first sample, inside the mapping. 0 while closed.
+    SampleFormat                  mFormat;
+    int                           mBytesPerSample;
+    int                           mNumChannels;
+    size_t                        mNumFrames;
+    float                         mFileSampleRate;
+    size_t                        mPosition;
+    float                         mPitch;
+    size_t                        mReadAheadFrames;
+    size_t                        mAdvisedEnd; // The byte offset into the mapping the read-ahead has been asked for up to
+    size_t                        mReleasedEnd; // The byte offset into the mapping the pages before which have been let go
+
+  };
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerMappedFile__) */
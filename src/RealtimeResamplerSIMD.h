@@ -0,0 +1,85 @@
+//
+//  RealtimeResamplerSIMD.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerSIMD__
+#define __EliasResamplerDemo__RealtimeResamplerSIMD__
+
+#include "RealtimeResamplerCommon.h"
+
+/*
+  Vector instruction support. The widest instruction set the compiler is targeting is used automatically (build with -mavx2
+  to get the 8-wide kernels). Define REALTIME_RESAMPLER_DISABLE_SIMD to force the scalar code paths everywhere.
+*/
+
+#if !defined(REALTIME_RESAMPLER_DISABLE_SIMD)
+  #if defined(__AVX2__)
+    #define REALTIME_RESAMPLER_AVX2 1
+    #define REALTIME_RESAMPLER_SIMD 1
+    #include <immintrin.h>
+  #elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define REALTIME_RESAMPLER_SSE 1
+    #define REALTIME_RESAMPLER_SIMD 1
+    #include <emmintrin.h>
+  #endif
+#endif
+
+namespace RealtimeResampler {
+
+#if defined(REALTIME_RESAMPLER_SIMD)
+
+  //////////////////////////////////////////
+  /// A register full of samples, and the handful of operations the kernels need.
+  //////////////////////////////////////////
+
+  struct SimdFloat {
+  
+  #if defined(REALTIME_RESAMPLER_AVX2)
+  
+    typedef __m256              Type;
+    enum {                      WIDTH = 8 };
+    
+    static inline Type          set1(SampleType value){ return _mm256_set1_ps(value); }
+    static inline Type          load(const SampleType* ptr){ return _mm256_loadu_ps(ptr); }
+    static inline void          store(SampleType* ptr, Type value){ _mm256_storeu_ps(ptr, value); }
+    static inline Type          add(Type a, Type b){ return _mm256_add_ps(a, b); }
+    static inline Type          sub(Type a, Type b){ return _mm256_sub_ps(a, b); }
+    static inline Type          mul(Type a, Type b){ return _mm256_mul_ps(a, b); }
+    static inline SampleType    sum(Type a){
+      __m128 half = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+      half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+      return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+    }
+    
+  #else
+  
+    typedef __m128              Type;
+    enum {                      WIDTH = 4 };
+    
+    static inline Type          set1(SampleType value){ return _mm_set1_ps(value); }
+    static inline Type          load(const SampleType* ptr){ return _mm_loadu_ps(ptr); }
+    static inline void          store(SampleType* ptr, Type value){ _mm_storeu_ps(ptr, value); }
+    static inline Type          add(Type a, Type b){ return _mm_add_ps(a, b); }
+    static inline Type          sub(Type a, Type b){ return _mm_sub_ps(a, b); }
+    static inline Type          mul(Type a, Type b){ return _mm_mul_ps(a, b); }
+    static inline SampleType    sum(Type a){
+      a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+      return _mm_cvtss_f32(_mm_add_ss(a, _mm_shuffle_ps(a, a, 1)));
+    }
+    
+  #endif
+  
+  };
+  
+#endif
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerSIMD__) */
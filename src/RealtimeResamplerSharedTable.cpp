@@ -0,0 +1,133 @@
+//
+//  RealtimeResamplerSharedTable.cpp
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "RealtimeResamplerSharedTable.h"
+#include "RealtimeResampler.h"
+#include <cstring>
+#include <cassert>
+#include <stdint.h>
+#include <mutex>
+
+namespace RealtimeResampler{
+
+  struct SharedTable::Entry {
+    const char*           name;
+    double                params[MAX_PARAMS];
+    int                   numParams;
+    size_t                numValues;
+    int                   refCount;
+    void*                 allocation;
+    SampleType*           values; // allocation, rounded up to ALIGNMENT
+    Entry*                next;
+  };
+  
+  SharedTable::Entry* SharedTable::sTables = 0;
+  
+  static std::mutex& tablesMutex(){
+    static std::mutex mutex;
+    return mutex;
+  }
+  
+  SharedTable::SharedTable():
+    mEntry(0)
+  {}
+  
+  SharedTable::SharedTable(const char* name, const double* params, int numParams, size_t numValues, BuildFn build):
+    mEntry(0)
+  {
+    assert(numParams <= MAX_PARAMS);
+    
+    std::lock_guard<std::mutex> lock(tablesMutex());
+    
+    for (Entry* entry = sTables; entry; entry = entry->next) {
+      if (entry->numValues == numValues && entry->numParams == numParams && strcmp(entry->name, name) == 0
+        && memcmp(entry->params, params, numParams * sizeof(double)) == 0)
+      {
+        entry->refCount++;
+        mEntry = entry;
+        return;
+      }
+    }
+    
+    Entry* entry = (Entry*)mallocFn(sizeof(Entry));
+    entry->name = name;
+    memset(entry->params, 0, sizeof(entry->params));
+    memcpy(entry->params, params, numParams * sizeof(double));
+    entry->numParams = numParams;
+    entry->numValues = numValues;
+    entry->refCount = 1;
+    entry->allocation = mallocFn(numValues * sizeof(SampleType) + ALIGNMENT);
+    entry->values = (SampleType*)(((uintptr_t)entry->allocation + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+    memset(entry->values, 0, numValues * sizeof(SampleType));
+    build(entry->values, numValues, entry->params);
+    entry->next = sTables;
+    sTables = entry;
+    mEntry = entry;
+  }
+  
+  SharedTable::~SharedTable(){
+    release();
+  }
+  
+  SharedTable::SharedTable(const SharedTable &other):
+    mEntry(0)
+  {
+    *this = other;
+  }
+  
+  SharedTable& SharedTable::operator= (const SharedTable& other){
+    if (mEntry == other.mEntry) {
+      return *this;
+    }
+    release();
+    std::lock_guard<std::mutex> lock(tablesMutex());
+    mEntry = other.mEntry;
+    if (mEntry) {
+      mEntry->refCount++;
+    }
+    return *this;
+  }
+  
+  void SharedTable::release(){
+    if (!mEntry) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(tablesMutex());
+    if (--mEntry->refCount == 0) {
+      Entry** link = &sTables;
+      while (*link != mEntry) {
+        link = &(*link)->next;
+      }
+      *link = mEntry->next;
+      freeFn(mEntry->allocation);
+      freeFn(mEntry);
+    }
+    mEntry = 0;
+  }
+  
+  const SampleType* SharedTable::getValues() const{
+    return mEntry ? mEntry->values : 0;
+  }
+  
+  size_t SharedTable::size() const{
+    return mEntry ? mEntry->numValues : 0;
+  }
+  
+  int SharedTable::numTables(){
+    std::lock_guard<std::mutex> lock(tablesMutex());
+    int count = 0;
+    for (Entry* entry = sTables; entry; entry = entry->next) {
+      count++;
+    }
+    return count;
+  }
+
+}
@@ -0,0 +1,74 @@
+//
+//  RealtimeResamplerSharedTable.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerSharedTable__
+#define __EliasResamplerDemo__RealtimeResamplerSharedTable__
+
+#include <stdio.h>
+#include "RealtimeResamplerCommon.h"
+
+namespace RealtimeResampler {
+
+      /*!
+        A read-only table of precomputed values (filter coefficients, for example), shared between every object that asks for
+        a table with the same name and parameters. The first request builds the table, later requests reuse it, and it's freed
+        when the last SharedTable referring to it goes away. The values start on a cache line boundary.
+       
+        Building or releasing a table allocates and takes a lock, so do it outside the audio thread. Copying a SharedTable
+        shares the values, it doesn't copy them.
+      */
+  
+      class SharedTable{
+      public:
+      
+        enum {                  MAX_PARAMS = 4, ALIGNMENT = 64 };
+      
+        // Fill in numValues values. params are the parameters the table was requested with.
+        typedef void            (*BuildFn)(SampleType* values, size_t numValues, const double* params);
+      
+        // An empty table
+        SharedTable();
+      
+        // Find or build the table identified by name and params. Up to MAX_PARAMS parameters. name must be a string literal,
+        // or otherwise outlive the table.
+        SharedTable(const char* name, const double* params, int numParams, size_t numValues, BuildFn build);
+      
+        ~SharedTable();
+      
+        // copy constructor
+        SharedTable(const SharedTable &other);
+      
+        // assignment operator
+        SharedTable& operator= (const SharedTable& other);
+      
+        const SampleType*       getValues() const;
+      
+        size_t                  size() const;
+      
+        // The number of distinct tables currently alive. For testing.
+        static int              numTables();
+      
+      protected:
+      
+        struct Entry;
+      
+        void                    release();
+      
+        // Every live table, in a linked list. There are only ever a handful.
+        static Entry*           sTables;
+      
+        Entry*                  mEntry;
+      
+      };
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerSharedTable__) */
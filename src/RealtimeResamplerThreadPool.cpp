@@ -0,0 +1,333 @@
+//
+//  RealtimeResamplerThreadPool.cpp
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "RealtimeResamplerThreadPool.h"
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__)
+  #include <pthread.h>
+  #include <sched.h>
+  #include <unistd.h>
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+#elif defined(__APPLE__)
+  #include <dispatch/dispatch.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <emmintrin.h>
+#endif
+
+namespace RealtimeResampler {
+
+  // The share of each render's load that goes into the average
+  static const float LOAD_SMOOTHING = 0.1f;
+
+  static double steadyClock(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // How many times a spinning thread pauses before giving up its core, for when there are more threads than cores
+  static const int SPINS_PER_YIELD = 256;
+
+  static inline void spinPause(int spin){
+    if (spin % SPINS_PER_YIELD == 0) {
+      std::this_thread::yield();
+      return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+  }
+
+  static inline uint64_t packTasks(uint32_t first, uint32_t end){
+    return ((uint64_t)first << 32) | end;
+  }
+
+  RenderThreadPool::RenderThreadPool(float sampleRate, int numChannels, int numThreads, size_t maxFramesToRender, bool pinWorkers) :
+    mSampleRate(sampleRate),
+    mNumChannels(numChannels),
+    mNumThreads(numThreads > 0 ? numThreads : std::max(1, (int)std::thread::hardware_concurrency())),
+    mMaxFramesToRender(maxFramesToRender),
+    mMaxTasks(mNumThreads * TASKS_PER_THREAD),
+    mSpinTime(0.002),
+    mThreads(new ThreadState[mNumThreads]),
+    mWorkers(new std::thread[mNumThreads - 1]),
+    mTaskMixes(mMaxTasks * maxFramesToRender, numChannels),
+    mScratch(mNumThreads * maxFramesToRender, numChannels),
+    mJobs(NULL),
+    mRenderJobFunction(NULL),
+    mNumJobs(0),
+    mNumTasks(0),
+    mNumFrames(0),
+    mGeneration(0),
+    mGate(-1),
+    mTasksDone(0),
+    mNumParked(0),
+    mQuit(false),
+    mMissedDeadlines(0),
+    mSemaphore(NULL)
+  {
+    for (int thread = 0; thread < mNumThreads; thread++) {
+      mThreads[thread].tasks.store(0);
+      mThreads[thread].busyTime = 0;
+      mThreads[thread].load.store(0);
+    }
+#if defined(__APPLE__)
+    mSemaphore = dispatch_semaphore_create(0);
+#endif
+    for (int thread = 1; thread < mNumThreads; thread++) {
+      mWorkers[thread - 1] = std::thread(&RenderThreadPool::workerLoop, this, thread);
+#if defined(__linux__)
+      // Leave the first core to the calling thread
+      int numCores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+      if (pinWorkers && numCores > 1) {
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(thread % numCores, &cores);
+        pthread_setaffinity_np(mWorkers[thread - 1].native_handle(), sizeof(cores), &cores);
+      }
+#endif
+    }
+  }
+
+  RenderThreadPool::~RenderThreadPool(){
+    mQuit.store(true);
+    wakeWorkers();
+    for (int thread = 1; thread < mNumThreads; thread++) {
+      mWorkers[thread - 1].join();
+    }
+#if defined(__APPLE__)
+    dispatch_release((dispatch_semaphore_t)mSemaphore);
+#endif
+    delete[] mWorkers;
+    delete[] mThreads;
+  }
+
+  void RenderThreadPool::setSpinTime(double seconds){
+    mSpinTime.store(seconds, std::memory_order_relaxed);
+  }
+
+  int RenderThreadPool::getNumThreads(){
+    return mNumThreads;
+  }
+
+  float RenderThreadPool::getLoad(int thread){
+    return mThreads[thread].load.load(std::memory_order_relaxed);
+  }
+
+  size_t RenderThreadPool::getMissedDeadlineCount(){
+    return mMissedDeadlines.load(std::memory_order_relaxed);
+  }
+
+  void RenderThreadPool::renderJobs(const void* jobs, RenderJobFunction renderJobFunction, int numJobs, SampleType* outputBuffer, size_t numFrames){
+    // Nothing to render, and no deadline to measure the load against
+    if (numFrames == 0) {
+      return;
+    }
+    double start = steadyClock();
+    mJobs = jobs;
+    mRenderJobFunction = renderJobFunction;
+    mNumJobs = numJobs;
+    for (int thread = 0; thread < mNumThreads; thread++) {
+      mThreads[thread].busyTime = 0;
+    }
+
+    for (size_t frame = 0; frame < numFrames; frame += mMaxFramesToRender) {
+      renderChunk(outputBuffer + frame * mNumChannels, std::min(mMaxFramesToRender, numFrames - frame));
+    }
+
+    double deadline = numFrames / mSampleRate;
+    if (steadyClock() - start > deadline) {
+      mMissedDeadlines.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (int thread = 0; thread < mNumThreads; thread++) {
+      float load = mThreads[thread].load.load(std::memory_order_relaxed);
+      load += LOAD_SMOOTHING * ((float)(mThreads[thread].busyTime / deadline) - load);
+      mThreads[thread].load.store(load, std::memory_order_relaxed);
+    }
+  }
+
+  void RenderThreadPool::renderChunk(SampleType* outputBuffer, size_t numFrames){
+    if (mNumJobs == 0) {
+      memset(outputBuffer, 0, numFrames * mNumChannels * sizeof(SampleType));
+      return;
+    }
+
+    // Split the jobs into tasks and deal them out, a run of consecutive tasks per thread. The gate is closed, so no
+    // worker is looking.
+    mNumFrames = numFrames;
+    mNumTasks = std::min(mNumJobs, mMaxTasks);
+    for (int thread = 0; thread < mNumThreads; thread++) {
+      mThreads[thread].tasks.store(packTasks(thread * mNumTasks / mNumThreads, (thread + 1) * mNumTasks / mNumThreads), std::memory_order_relaxed);
+    }
+    mTasksDone.store(0, std::memory_order_relaxed);
+
+    // Open the gate and wake the workers, then join in
+    mGate.store(0, std::memory_order_release);
+    wakeWorkers();
+    work(0);
+
+    // Wait for the tasks other threads have taken, then close the gate once they're all out
+    for (int spin = 1; mTasksDone.load(std::memory_order_acquire) < mNumTasks; spin++) {
+      spinPause(spin);
+    }
+    int open = 0;
+    for (int spin = 1; !mGate.compare_exchange_weak(open, -1, std::memory_order_acquire); spin++) {
+      open = 0;
+      spinPause(spin);
+    }
+
+    // Add the tasks' mixes up in order
+    const size_t numSamples = numFrames * mNumChannels;
+    const SampleType* taskMix = mTaskMixes.getStartPtr();
+    memcpy(outputBuffer, taskMix, numSamples * sizeof(SampleType));
+    for (int task = 1; task < mNumTasks; task++) {
+      taskMix += mMaxFramesToRender * mNumChannels;
+      for (size_t i = 0; i < numSamples; i++) {
+        outputBuffer[i] += taskMix[i];
+      }
+    }
+  }
+
+  void RenderThreadPool::work(int thread){
+    SampleType* scratch = mScratch.getStartPtr() + thread * mMaxFramesToRender * mNumChannels;
+    double busyTime = 0;
+    while (true) {
+      int task = takeTask(thread);
+      if (task < 0) {
+        task = stealTask(thread);
+      }
+      if (task < 0) {
+        break;
+      }
+      double start = steadyClock();
+      runTask(task, scratch);
+      busyTime += steadyClock() - start;
+      mTasksDone.fetch_add(1, std::memory_order_release);
+    }
+    mThreads[thread].busyTime += busyTime;
+  }
+
+  int RenderThreadPool::takeTask(int thread){
+    // From the front of the thread's own tasks
+    std::atomic<uint64_t>& tasks = mThreads[thread].tasks;
+    uint64_t range = tasks.load(std::memory_order_relaxed);
+    while (true) {
+      uint32_t first = (uint32_t)(range >> 32);
+      uint32_t end = (uint32_t)range;
+      if (first >= end) {
+        return -1;
+      }
+      if (tasks.compare_exchange_weak(range, packTasks(first + 1, end), std::memory_order_acq_rel)) {
+        return (int)first;
+      }
+    }
+  }
+
+  int RenderThreadPool::stealTask(int thread){
+    // From the back of the other threads' tasks, starting with the next thread along
+    for (int i = 1; i < mNumThreads; i++) {
+      std::atomic<uint64_t>& tasks = mThreads[(thread + i) % mNumThreads].tasks;
+      uint64_t range = tasks.load(std::memory_order_relaxed);
+      while (true) {
+        uint32_t first = (uint32_t)(range >> 32);
+        uint32_t end = (uint32_t)range;
+        if (first >= end) {
+          break;
+        }
+        if (tasks.compare_exchange_weak(range, packTasks(first, end - 1), std::memory_order_acq_rel)) {
+          return (int)end - 1;
+        }
+      }
+    }
+    return -1;
+  }
+
+  void RenderThreadPool::runTask(int task, SampleType* scratch){
+    // The task's jobs are the task'th share of them. The first renders straight into the task's mix.
+    const int firstJob = task * mNumJobs / mNumTasks;
+    const int endJob = (task + 1) * mNumJobs / mNumTasks;
+    const size_t numSamples = mNumFrames * mNumChannels;
+    SampleType* taskMix = mTaskMixes.getStartPtr() + task * mMaxFramesToRender * mNumChannels;
+    mRenderJobFunction(mJobs, firstJob, taskMix, mNumFrames);
+    for (int job = firstJob + 1; job < endJob; job++) {
+      mRenderJobFunction(mJobs, job, scratch, mNumFrames);
+      for (size_t i = 0; i < numSamples; i++) {
+        taskMix[i] += scratch[i];
+      }
+    }
+  }
+
+  void RenderThreadPool::workerLoop(int thread){
+    // Start from the pool's first generation, not the current one, so a worker that starts late doesn't miss a render, or
+    // being told to quit
+    uint32_t generation = 0;
+    while (true) {
+      generation = waitForRender(generation);
+      if (mQuit.load()) {
+        return;
+      }
+      // Only work on a render that's open. One that's finished may already be being replaced.
+      int inside = mGate.load(std::memory_order_relaxed);
+      while (inside >= 0 && !mGate.compare_exchange_weak(inside, inside + 1, std::memory_order_acquire)) {}
+      if (inside >= 0) {
+        work(thread);
+        mGate.fetch_sub(1, std::memory_order_release);
+      }
+    }
+  }
+
+  uint32_t RenderThreadPool::waitForRender(uint32_t generation){
+    // Spin for a while, checking the clock now and again, then park
+    double spinUntil = steadyClock() + mSpinTime.load(std::memory_order_relaxed);
+    for (int spin = 1; mGeneration.load(std::memory_order_acquire) == generation; spin++) {
+      spinPause(spin);
+      if (spin % SPINS_PER_YIELD == 0 && steadyClock() > spinUntil) {
+        // Counting ourselves as parked before checking the generation again means a render that starts in between sees
+        // the count and wakes us.
+        mNumParked.fetch_add(1);
+        while (mGeneration.load() == generation) {
+#if defined(__linux__)
+          syscall(SYS_futex, (uint32_t*)&mGeneration, FUTEX_WAIT_PRIVATE, generation, NULL, NULL, 0);
+#elif defined(__APPLE__)
+          dispatch_semaphore_wait((dispatch_semaphore_t)mSemaphore, DISPATCH_TIME_FOREVER);
+#else
+          std::this_thread::yield();
+#endif
+        }
+        mNumParked.fetch_sub(1);
+      }
+    }
+    return mGeneration.load(std::memory_order_acquire);
+  }
+
+  void RenderThreadPool::wakeWorkers(){
+    mGeneration.fetch_add(1);
+    int numParked = mNumParked.load();
+    if (numParked > 0) {
+#if defined(__linux__)
+      syscall(SYS_futex, (uint32_t*)&mGeneration, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#elif defined(__APPLE__)
+      // A worker that sees the new generation before waiting leaves its signal behind, which only wakes it early later on
+      for (int i = 0; i < numParked; i++) {
+        dispatch_semaphore_signal((dispatch_semaphore_t)mSemaphore);
+      }
+#endif
+    }
+  }
+
+}
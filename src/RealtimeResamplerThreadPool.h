@@ -0,0 +1,154 @@
+//
+//  RealtimeResamplerThreadPool.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerThreadPool__
+#define __EliasResamplerDemo__RealtimeResamplerThreadPool__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include "RealtimeResamplerBuffer.h"
+
+namespace RealtimeResampler {
+
+  //////////////////////////////////////////
+  /// Render thread pool
+  //////////////////////////////////////////
+
+  /*!
+    Renders many Renderers, VoiceBanks or anything else with a render(SampleType* outputBuffer, size_t numFrames) that
+    overwrites the buffer, on several threads at once, and mixes them into one output, all within one audio callback.
+
+    The calling thread is one of the threads, and the others are workers the pool starts and keeps. Each render splits
+    the jobs into runs of consecutive jobs, called tasks, and deals the tasks out to the threads. A thread works through its
+    own tasks from the front, and once they're gone steals from the back of the others', so a thread that's slow to wake
+    or stuck on heavy jobs is covered by the rest. Each task mixes its jobs into its own buffer, and the calling thread adds
+    the tasks' mixes up in order at the end, so the output doesn't depend on which thread ran which task.
+
+    Between renders the workers spin for a while, so they're awake for the next callback, and then park until woken: on a
+    futex on Linux, and a semaphore on Apple platforms. On Linux they can be pinned, one to each core after the first.
+    Nothing allocates or locks once constructed, and the calling thread never waits on anything but the other threads
+    finishing the tasks they've started.
+
+    Only one thread may call render. The jobs must all have the pool's channel count, and each job is only rendered by one
+    thread at a time. The load and deadline counts can be read from any thread.
+  */
+
+  class RenderThreadPool{
+  public:
+
+    /*!
+      numThreads counts the calling thread, so numThreads - 1 workers are started. 0 uses one per core. sampleRate is only
+      used to work out each render's deadline.
+    */
+
+    RenderThreadPool(float sampleRate, int numChannels, int numThreads = 0, size_t maxFramesToRender = 64, bool pinWorkers = true);
+    ~RenderThreadPool();
+
+    /*!
+      Render numJobs jobs and mix them into outputBuffer, replacing what's there. Any number of frames may be requested;
+      they're rendered in chunks of maxFramesToRender.
+    */
+
+    template<class Job>
+    void                        render(Job* const* jobs, int numJobs, SampleType* outputBuffer, size_t numFrames);
+
+    /*!
+      How long the workers spin after a render before parking. Longer means they're more likely to be awake when the next
+      render starts, at the cost of keeping their cores busy. The default is 2ms.
+    */
+
+    void                        setSpinTime(double seconds);
+
+    int                         getNumThreads();
+
+    /*!
+      The share of each render's deadline, numFrames / sampleRate, that a thread spent rendering, averaged over recent
+      renders. Thread 0 is the calling thread.
+    */
+
+    float                       getLoad(int thread);
+
+    // The renders that took longer than their deadline
+    size_t                      getMissedDeadlineCount();
+
+    const static int            TASKS_PER_THREAD = 4;
+
+  protected:
+
+    RenderThreadPool(const RenderThreadPool&);
+    RenderThreadPool& operator= (const RenderThreadPool&);
+
+    typedef void                (*RenderJobFunction)(const void* jobs, int job, SampleType* outputBuffer, size_t numFrames);
+
+    template<class Job>
+    static void                 renderJob(const void* jobs, int job, SampleType* outputBuffer, size_t numFrames);
+
+    // Per thread, padded so threads don't share cache lines
+    struct ThreadState{
+      std::atomic<uint64_t>     tasks; // the tasks left to run, first in the high 32 bits and end in the low
+      double                    busyTime; // seconds spent running tasks in this render
+      std::atomic<float>        load;
+      char                      padding[64];
+    };
+
+    void                        renderJobs(const void* jobs, RenderJobFunction renderJobFunction, int numJobs, SampleType* outputBuffer, size_t numFrames);
+    void                        renderChunk(SampleType* outputBuffer, size_t numFrames);
+    void                        work(int thread);
+    int                         takeTask(int thread);
+    int                         stealTask(int thread);
+    void                        runTask(int task, SampleType* scratch);
+    void                        workerLoop(int thread);
+    uint32_t                    waitForRender(uint32_t generation);
+    void                        wakeWorkers();
+
+    float                       mSampleRate;
+    int                         mNumChannels;
+    int                         mNumThreads;
+    size_t                      mMaxFramesToRender;
+    int                         mMaxTasks;
+    std::atomic<double>         mSpinTime;
+    ThreadState*                mThreads;
+    std::thread*                mWorkers; // mNumThreads - 1 of them
+    Buffer                      mTaskMixes; // mMaxFramesToRender frames per task
+    Buffer                      mScratch; // mMaxFramesToRender frames per thread
+
+    // The render in progress. Set by the calling thread while the gate is closed.
+    const void*                 mJobs;
+    RenderJobFunction           mRenderJobFunction;
+    int                         mNumJobs;
+    int                         mNumTasks;
+    size_t                      mNumFrames;
+
+    std::atomic<uint32_t>       mGeneration; // counts renders, to wake the workers
+    std::atomic<int>            mGate; // the threads working on the render in progress, or -1 between renders
+    std::atomic<int>            mTasksDone;
+    std::atomic<int>            mNumParked;
+    std::atomic<bool>           mQuit;
+    std::atomic<size_t>         mMissedDeadlines;
+    void*                       mSemaphore; // used to park the workers where there's no futex
+
+  };
+
+  template<class Job>
+  void RenderThreadPool::render(Job* const* jobs, int numJobs, SampleType* outputBuffer, size_t numFrames){
+    renderJobs(jobs, renderJob<Job>, numJobs, outputBuffer, numFrames);
+  }
+
+  template<class Job>
+  void RenderThreadPool::renderJob(const void* jobs, int job, SampleType* outputBuffer, size_t numFrames){
+    ((Job* const*)jobs)[job]->render(outputBuffer, numFrames);
+  }
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerThreadPool__) */
@@ -0,0 +1,276 @@
+//
+//  RealtimeResamplerVoiceBank.cpp
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "RealtimeResamplerVoiceBank.h"
+#include "RealtimeResampler.h"
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+namespace RealtimeResampler {
+
+  template<class T>
+  T* VoiceBank::allocate(size_t count){
+    T* values = (T*)(*mallocFn)(count * sizeof(T));
+    memset(values, 0, count * sizeof(T));
+    return values;
+  }
+
+  VoiceBank::VoiceBank(float sampleRate, int numChannels, int maxVoices, size_t maxFramesToRender) :
+    mSampleRate(sampleRate),
+    mNumChannels(numChannels),
+    mMaxVoices(maxVoices),
+    mMaxFramesToRender(maxFramesToRender),
+    mCutoffToNyquistRatio(0.9),
+    mCoefTable(IIRFilter::lowPassCoefTable(IIRFilter::Q_MIN)),
+    mNumPlaying(0),
+    // a chunk's frames can reach up to MAX_PITCH * maxFramesToRender frames on, and the interpolator looks 2 past that
+    mFiltered(TAIL_FRAMES + MAX_PITCH * (maxFramesToRender + 1) + 3, numChannels),
+    mIndex(maxFramesToRender),
+    mFraction(maxFramesToRender, 1)
+  {
+    mPlaying = allocate<int>(maxVoices);
+    mSlot = allocate<int>(maxVoices);
+    mFrames = allocate<const SampleType*>(maxVoices);
+    mNumFrames = allocate<size_t>(maxVoices);
+    mPosition = allocate<double>(maxVoices);
+    mPitch = allocate<double>(maxVoices);
+    mPitchChangePerFrame = allocate<double>(maxVoices);
+    mPitchDestination = allocate<float>(maxVoices);
+    mFramesUntilPitchDestination = allocate<size_t>(maxVoices);
+    mGain = allocate<SampleType>(maxVoices);
+    mFirstFrame = allocate<int64_t>(maxVoices);
+    mFilteredEnd = allocate<int64_t>(maxVoices);
+    mCutoff = allocate<SampleType>(maxVoices);
+    mCoef = allocate<SampleType>(maxVoices * 5);
+    mHistory = allocate<SampleType>(maxVoices * 4 * numChannels);
+    mTail = allocate<SampleType>(maxVoices * TAIL_FRAMES * numChannels);
+    for (int voice = 0; voice < maxVoices; voice++) {
+      mSlot[voice] = -1;
+    }
+  }
+
+  VoiceBank::~VoiceBank(){
+    freeFn(mPlaying);
+    freeFn(mSlot);
+    freeFn(mFrames);
+    freeFn(mNumFrames);
+    freeFn(mPosition);
+    freeFn(mPitch);
+    freeFn(mPitchChangePerFrame);
+    freeFn(mPitchDestination);
+    freeFn(mFramesUntilPitchDestination);
+    freeFn(mGain);
+    freeFn(mFirstFrame);
+    freeFn(mFilteredEnd);
+    freeFn(mCutoff);
+    freeFn(mCoef);
+    freeFn(mHistory);
+    freeFn(mTail);
+  }
+
+  int VoiceBank::startVoice(const SampleType* frames, size_t numFrames, double startFrame, float pitch, float gain){
+    if (mNumPlaying == mMaxVoices) {
+      return -1;
+    }
+    int voice = 0;
+    while (mSlot[voice] != -1) {
+      voice++;
+    }
+    mSlot[voice] = mNumPlaying;
+    mPlaying[mNumPlaying++] = voice;
+    mFrames[voice] = frames;
+    mNumFrames[voice] = numFrames;
+    mPosition[voice] = startFrame;
+    mGain[voice] = gain;
+    setPitch(voice, pitch, pitch, 0);
+    // The frames before the start are silent, as they'd be to a Renderer, and filtering starts from the one before it
+    mFirstFrame[voice] = std::max((int64_t)floor(startFrame), (int64_t)0);
+    mFilteredEnd[voice] = (int64_t)floor(startFrame) - 1;
+    mCutoff[voice] = -1;
+    memset(mHistory + voice * 4 * mNumChannels, 0, 4 * mNumChannels * sizeof(SampleType));
+    memset(mTail + voice * TAIL_FRAMES * mNumChannels, 0, TAIL_FRAMES * mNumChannels * sizeof(SampleType));
+    return voice;
+  }
+
+  void VoiceBank::setPitch(int voice, float start, float end, float glideDuration){
+    start = std::min(std::max(start, 0.0f), (float)MAX_PITCH);
+    end = std::min(std::max(end, 0.0f), (float)MAX_PITCH);
+    mPitch[voice] = start;
+    mPitchDestination[voice] = end;
+    mFramesUntilPitchDestination[voice] = glideDuration > 0 ? std::max((size_t)1, (size_t)(glideDuration * mSampleRate + 0.5)) : 0;
+    mPitchChangePerFrame[voice] = mFramesUntilPitchDestination[voice] > 0 ? ((double)end - start) / mFramesUntilPitchDestination[voice] : 0;
+  }
+
+  void VoiceBank::setGain(int voice, float gain){
+    mGain[voice] = gain;
+  }
+
+  void VoiceBank::stopVoice(int voice){
+    int slot = mSlot[voice];
+    if (slot == -1) {
+      return;
+    }
+    // move the last playing voice into the gap
+    int last = mPlaying[--mNumPlaying];
+    mPlaying[slot] = last;
+    mSlot[last] = slot;
+    mSlot[voice] = -1;
+  }
+
+  void VoiceBank::stopAllVoices(){
+    while (mNumPlaying > 0) {
+      stopVoice(mPlaying[0]);
+    }
+  }
+
+  bool VoiceBank::isPlaying(int voice){
+    return mSlot[voice] != -1;
+  }
+
+  int VoiceBank::getNumPlayingVoices(){
+    return mNumPlaying;
+  }
+
+  double VoiceBank::getPosition(int voice){
+    return mPosition[voice];
+  }
+
+  void VoiceBank::setCutoffToNyquistRatio(float ratio){
+    mCutoffToNyquistRatio = ratio;
+  }
+
+  void VoiceBank::render(SampleType* outputBuffer, size_t numFrames){
+    memset(outputBuffer, 0, numFrames * mNumChannels * sizeof(SampleType));
+    for (size_t frame = 0; frame < numFrames; frame += mMaxFramesToRender) {
+      renderChunk(outputBuffer + frame * mNumChannels, std::min(mMaxFramesToRender, numFrames - frame));
+    }
+  }
+
+  void VoiceBank::renderChunk(SampleType* outputBuffer, size_t numFrames){
+    // Voices that stop are swapped with the last playing one, so walk the list backwards to visit each once
+    for (int slot = mNumPlaying - 1; slot >= 0; slot--) {
+      int voice = mPlaying[slot];
+      if (mNumChannels == 1) {
+        renderVoice<1>(voice, outputBuffer, numFrames);
+      }else if (mNumChannels == 2) {
+        renderVoice<2>(voice, outputBuffer, numFrames);
+      }else{
+        renderVoice<0>(voice, outputBuffer, numFrames);
+      }
+      if (mPosition[voice] >= mNumFrames[voice] + 1) {
+        stopVoice(voice);
+      }
+    }
+  }
+
+  template<int NumChannels>
+  void VoiceBank::renderVoice(int voice, SampleType* outputBuffer, size_t numFrames){
+
+    const int channels = NumChannels ? NumChannels : mNumChannels;
+    int* indexBuffer = mIndex.getStartPtr();
+    SampleType* fractionBuffer = mFraction.getStartPtr();
+    SampleType* filtered = mFiltered.getStartPtr();
+
+    // Work out where each output frame falls, relative to the first frame in the filtered scratch space: the tail kept
+    // from the last chunk, then the frames filtered for this one. A chunk can start on the last frame of the one before,
+    // and the interpolator looks one frame back from that, so the tail is enough to cover it.
+    const int64_t firstFrame = mFilteredEnd[voice] - TAIL_FRAMES;
+    double position = mPosition[voice];
+    double pitch = mPitch[voice];
+    double pitchChangePerFrame = mPitchChangePerFrame[voice];
+    size_t framesUntilPitchDestination = mFramesUntilPitchDestination[voice];
+    double middlePitch = pitch;
+    for (size_t i = 0; i < numFrames; i++) {
+      double frame = floor(position);
+      indexBuffer[i] = (int)((int64_t)frame - firstFrame);
+      fractionBuffer[i] = (SampleType)(position - frame);
+      if (i == numFrames / 2) {
+        middlePitch = pitch;
+      }
+      position += pitch;
+      if (framesUntilPitchDestination > 0) {
+        if (--framesUntilPitchDestination == 0) {
+          pitch = mPitchDestination[voice];
+        }else{
+          pitch += pitchChangePerFrame;
+        }
+      }
+    }
+    mPosition[voice] = position;
+    mPitch[voice] = pitch;
+    mFramesUntilPitchDestination[voice] = framesUntilPitchDestination;
+
+    // Copy the new source frames, up to the last one the interpolator reads, after the tail. Frames before the start or
+    // after the end of the buffer are silent.
+    const int lastIndex = indexBuffer[numFrames - 1] + 2;
+    const int numNewFrames = std::max(0, lastIndex + 1 - TAIL_FRAMES);
+    SampleType* tail = mTail + voice * TAIL_FRAMES * channels;
+    memcpy(filtered, tail, TAIL_FRAMES * channels * sizeof(SampleType));
+    SampleType* newFrames = filtered + TAIL_FRAMES * channels;
+    const int64_t sourceStart = mFilteredEnd[voice];
+    const int64_t bufferStart = std::min(std::max((int64_t)0, mFirstFrame[voice] - sourceStart), (int64_t)numNewFrames);
+    const int64_t bufferEnd = std::max(bufferStart, std::min((int64_t)numNewFrames, (int64_t)mNumFrames[voice] - sourceStart));
+    memset(newFrames, 0, bufferStart * channels * sizeof(SampleType));
+    memcpy(newFrames + bufferStart * channels, mFrames[voice] + (sourceStart + bufferStart) * channels, (bufferEnd - bufferStart) * channels * sizeof(SampleType));
+    memset(newFrames + bufferEnd * channels, 0, (numNewFrames - bufferEnd) * channels * sizeof(SampleType));
+
+    // No need to anti-alias if we're pitching down. Otherwise the cutoff follows the pitch halfway through the chunk.
+    const bool filter = middlePitch > 1;
+    SampleType* coef = mCoef + voice * 5;
+    if (filter) {
+      SampleType cutoff = mCutoffToNyquistRatio * mSampleRate / (2 * (SampleType)middlePitch);
+      if (cutoff != mCutoff[voice]) {
+        mCutoff[voice] = cutoff;
+        IIRFilter::lowPassCoef(mCoefTable, cutoff, mSampleRate, coef);
+      }
+    }
+    SampleType* history = mHistory + voice * 4 * channels;
+    const SampleType c0 = coef[0], c1 = coef[1], c2 = coef[2], c3 = coef[3], c4 = coef[4];
+    for (int chan = 0; filter && chan < channels; chan++) {
+      SampleType x1 = history[chan];
+      SampleType x2 = history[channels + chan];
+      SampleType y1 = history[2 * channels + chan];
+      SampleType y2 = history[3 * channels + chan];
+      SampleType* sample = newFrames + chan;
+      for (int i = 0; i < numNewFrames; i++) {
+        SampleType x = *sample;
+        SampleType y = x*c0 + x1*c1 + x2*c2 - y1*c3 - y2*c4;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        *sample = y;
+        sample += channels;
+      }
+      history[chan] = x1;
+      history[channels + chan] = x2;
+      history[2 * channels + chan] = y1;
+      history[3 * channels + chan] = y2;
+    }
+    mFilteredEnd[voice] += numNewFrames;
+    memcpy(tail, filtered + numNewFrames * channels, TAIL_FRAMES * channels * sizeof(SampleType));
+
+    // Interpolate into the mix
+    const SampleType gain = mGain[voice];
+    for (size_t i = 0; i < numFrames; i++) {
+      SampleType w[4];
+      HermiteInterpolator::weights(fractionBuffer[i], w);
+      const SampleType* taps = filtered + (indexBuffer[i] - 1) * channels;
+      SampleType* out = outputBuffer + i * channels;
+      for (int chan = 0; chan < channels; chan++) {
+        out[chan] += gain * (w[0] * taps[chan] + w[1] * taps[channels + chan] + w[2] * taps[2 * channels + chan] + w[3] * taps[3 * channels + chan]);
+      }
+    }
+  }
+
+}
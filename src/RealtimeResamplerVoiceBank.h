@@ -0,0 +1,127 @@
+//
+//  RealtimeResamplerVoiceBank.h
+//  Resampler
+//
+//  Created by Morgan Packard with encouragement and guidance from Philip Bennefall on 2/22/15.
+//
+//  Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef __EliasResamplerDemo__RealtimeResamplerVoiceBank__
+#define __EliasResamplerDemo__RealtimeResamplerVoiceBank__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "RealtimeResamplerBuffer.h"
+#include "RealtimeResamplerSharedTable.h"
+
+namespace RealtimeResampler {
+
+  //////////////////////////////////////////
+  /// Voice bank
+  //////////////////////////////////////////
+
+  /*!
+    Plays many in-memory buffers at once, each at its own pitch and gain, and mixes them into one output. It's the
+    equivalent of a Renderer with a HermiteInterpolator and an LPF12 per voice, reading its buffer through an AudioSource,
+    without the objects: each voice's read head, pitch glide, filter coefficients and filter history are kept in arrays
+    indexed by voice, and all the playing voices are rendered in one pass over them. The source frames are filtered
+    straight from the buffer into scratch space shared by every voice, and interpolated straight into the mix, so there's
+    no ring buffer, virtual call or output buffer per voice.
+
+    As in the Renderer, each voice's anti-aliasing cutoff follows its pitch, and there's no filtering while pitching down.
+    The pitch is taken once per chunk of up to maxFramesToRender frames, halfway through. With a steady pitch a voice
+    sounds the same, to rounding, as the Renderer.
+
+    Voices play once through, from any starting frame, and stop once the read head is past the end of the buffer. The frames
+    before the starting frame are silent, as if the buffer began there. The buffers aren't copied, and must stay alive
+    while their voices play. Nothing allocates or locks after construction.
+  */
+
+  class VoiceBank{
+  public:
+
+    VoiceBank(float sampleRate, int numChannels, int maxVoices, size_t maxFramesToRender = 64);
+    ~VoiceBank();
+
+    /*!
+      Start playing numFrames interleaved frames, with the bank's channel count, from startFrame. Returns the voice, or -1 if
+      they're all playing. A voice's number is reused once it stops, so check isPlaying before changing one that may have.
+    */
+
+    int                         startVoice(const SampleType* frames, size_t numFrames, double startFrame = 0, float pitch = 1, float gain = 1);
+
+    // As Renderer::setPitch. Pitches are limited to between 0 and MAX_PITCH.
+    void                        setPitch(int voice, float start, float end, float glideDuration);
+    void                        setGain(int voice, float gain);
+    void                        stopVoice(int voice);
+    void                        stopAllVoices();
+    bool                        isPlaying(int voice);
+    int                         getNumPlayingVoices();
+
+    // The position of the next frame in the voice's buffer
+    double                      getPosition(int voice);
+
+    /*!
+      Mix numFrames frames of every playing voice into outputBuffer, replacing what's there. Any number of frames may be
+      requested; they're rendered in chunks of maxFramesToRender.
+    */
+
+    void                        render(SampleType* outputBuffer, size_t numFrames);
+
+    // As Filter::setCutoffToNyquistRatio, for every voice
+    void                        setCutoffToNyquistRatio(float ratio);
+
+    const static int            MAX_PITCH = 8; // bounds the source frames a chunk can use, and so the scratch space
+
+  protected:
+
+    VoiceBank(const VoiceBank&);
+    VoiceBank& operator= (const VoiceBank&);
+
+    enum {                      TAIL_FRAMES = 4 }; // the filtered frames kept between chunks, for the interpolator to look back on
+
+    void                        renderChunk(SampleType* outputBuffer, size_t numFrames);
+    template<int NumChannels>
+    void                        renderVoice(int voice, SampleType* outputBuffer, size_t numFrames);
+    template<class T>
+    static T*                   allocate(size_t count);
+
+    float                       mSampleRate;
+    int                         mNumChannels;
+    int                         mMaxVoices;
+    size_t                      mMaxFramesToRender;
+    float                       mCutoffToNyquistRatio;
+    SharedTable                 mCoefTable;
+
+    // The voices. Each array is indexed by voice, times the samples per voice for the last few
+    int*                        mPlaying; // The playing voices, in no particular order
+    int                         mNumPlaying;
+    int*                        mSlot; // Each voice's index in mPlaying, or -1 if it isn't playing
+    const SampleType**          mFrames;
+    size_t*                     mNumFrames;
+    double*                     mPosition;
+    double*                     mPitch;
+    double*                     mPitchChangePerFrame;
+    float*                      mPitchDestination;
+    size_t*                     mFramesUntilPitchDestination;
+    SampleType*                 mGain;
+    int64_t*                    mFirstFrame; // The frame the voice started on
+    int64_t*                    mFilteredEnd; // The source frame after the last one filtered
+    SampleType*                 mCutoff;
+    SampleType*                 mCoef; // 5 per voice
+    SampleType*                 mHistory; // [x1, x2, y1, y2][channel] per voice
+    SampleType*                 mTail; // The last TAIL_FRAMES filtered frames per voice
+
+    // Scratch space shared by the voices
+    Buffer                      mFiltered; // the tail, then the chunk's filtered source frames
+    IndexBuffer                 mIndex; // The filtered frame each output frame is interpolated from,
+    Buffer                      mFraction; // and the fraction past it
+
+  };
+
+}
+
+#endif /* defined(__EliasResamplerDemo__RealtimeResamplerVoiceBank__) */